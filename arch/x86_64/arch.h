@@ -152,6 +152,53 @@
 
 
 
+/****************************************************************************************************************//**
+*   @def                INIT_CODE
+*   @brief              Inform the compiler to place this function in the .kinit.text section for the kernel
+*
+*   The `.kinit` section holds the code and data which are only used to boot the kernel.  Its frames are returned
+*   to the PMM once all the CPUs have been started, so nothing marked this way may be referenced after that.
+*///----------------------------------------------------------------------------------------------------------------
+#define INIT_CODE       __attribute__((section(".kinit.text")))
+
+
+
+/****************************************************************************************************************//**
+*   @def                INIT_DATA
+*   @brief              Inform the compiler to place this variable in the .kinit.data section for the kernel
+*///----------------------------------------------------------------------------------------------------------------
+#define INIT_DATA       __attribute__((section(".kinit.data")))
+
+
+
+/****************************************************************************************************************//**
+*   @def                INIT_FUNC
+*   @brief              This is a function to be placed in the boot-only section
+*///----------------------------------------------------------------------------------------------------------------
+#define INIT_FUNC       EXTERNC INIT_CODE
+
+
+
+/****************************************************************************************************************//**
+*   @def                PER_CPU
+*   @brief              Inform the compiler to place this variable in the .percpu section; each CPU has its own copy
+*
+*   The `.percpu` section is linked at address 0, so the address of a per-CPU variable is its offset in a CPU's
+*   block and must never be dereferenced.  Reach this CPU's copy with \ref PerCpuRead and \ref PerCpuWrite, and
+*   any CPU's copy with \ref PerCpuPtr.
+*///----------------------------------------------------------------------------------------------------------------
+#define PER_CPU         __attribute__((section(".percpu")))
+
+
+
+/****************************************************************************************************************//**
+*   @def                PER_CPU_FIRST
+*   @brief              Place this variable at the start of each CPU's per-CPU block; only for \ref cpuLocal
+*///----------------------------------------------------------------------------------------------------------------
+#define PER_CPU_FIRST   __attribute__((section(".percpu.first")))
+
+
+
 
 
 
@@ -159,8 +206,11 @@
 /****************************************************************************************************************//**
 *   @def                MAX_CPU
 *   @brief              The maximum number of CPUs supported on this architecture
+*
+*   Only small per-CPU tables are sized by this limit.  The \ref Cpu_t blocks, descriptor tables, TSSes and stacks
+*   are allocated at boot for the CPUs the MADT reports.
 *///----------------------------------------------------------------------------------------------------------------
-#define MAX_CPU 4
+#define MAX_CPU 256
 
 
 
@@ -180,6 +230,114 @@
 
 
 
+/****************************************************************************************************************//**
+*   @def                CR4_PCIDE
+*   @brief              The CR4 bit which enables Process Context Identifiers; it can only be set in long mode
+*///----------------------------------------------------------------------------------------------------------------
+#define CR4_PCIDE ((Addr_t)1 << 17)
+
+
+
+/****************************************************************************************************************//**
+*   @def                CR3_NOFLUSH
+*   @brief              When PCIDs are enabled, a CR3 write with this bit set keeps the TLB entries for the new PCID
+*///----------------------------------------------------------------------------------------------------------------
+#define CR3_NOFLUSH ((Addr_t)1 << 63)
+
+
+
+/****************************************************************************************************************//**
+*   @def                IPI_TLB_SHOOTDOWN
+*   @brief              The interrupt vector used to ask other CPUs to invalidate TLB entries
+*///----------------------------------------------------------------------------------------------------------------
+#define IPI_TLB_SHOOTDOWN 0xf0
+
+
+
+/****************************************************************************************************************//**
+*   @def                KERNEL_BASE
+*   @brief              The virtual address at which physical address 0 is mapped for the kernel image
+*///----------------------------------------------------------------------------------------------------------------
+#define KERNEL_BASE 0xffffc00000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                USER_SPACE_END
+*   @brief              The end of the lower half of the address space, which belongs to each address space; the
+*                       upper half is shared by all address spaces and belongs to the kernel
+*///----------------------------------------------------------------------------------------------------------------
+#define USER_SPACE_END 0x0000800000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                DIRECT_MAP_ADDR
+*   @brief              The virtual address at which physical address 0 is mapped in the direct map of physical memory
+*///----------------------------------------------------------------------------------------------------------------
+#define DIRECT_MAP_ADDR 0xffff800000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                DIRECT_MAP_SIZE
+*   @brief              The amount of physical memory the direct map can cover (64T, up to \ref KERNEL_BASE)
+*///----------------------------------------------------------------------------------------------------------------
+#define DIRECT_MAP_SIZE 0x0000400000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                KVA_ADDR
+*   @brief              The start of the kernel virtual address space handed out by the KVA allocator
+*///----------------------------------------------------------------------------------------------------------------
+#define KVA_ADDR 0xffffe00000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                KVA_SIZE
+*   @brief              The size of the kernel virtual address space handed out by the KVA allocator (1T)
+*///----------------------------------------------------------------------------------------------------------------
+#define KVA_SIZE 0x0000010000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_BITMAP_ADDR
+*   @brief              The virtual address where the PMM frame bitmap is mapped
+*///----------------------------------------------------------------------------------------------------------------
+#define PMM_BITMAP_ADDR 0xffffd00000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_BENCH_ADDR
+*   @brief              The virtual address where the PMM's boot-time benchmark maps the frames it measures
+*///----------------------------------------------------------------------------------------------------------------
+#define PMM_BENCH_ADDR 0xffffd10000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                MMU_SCRATCH_ADDR
+*   @brief              The virtual address of the per-CPU scratch pages used by the MMU to build paging tables
+*
+*   Each CPU uses the page at `MMU_SCRATCH_ADDR + (cpu * PAGE_SIZE)`.  The page table for them is built by
+*   \ref ArchMmuInit and never released; it is in a different PML4 entry from anything which is unmapped.
+*///----------------------------------------------------------------------------------------------------------------
+#define MMU_SCRATCH_ADDR 0xffffd18000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                FRAME_DESC_ADDR
+*   @brief              The virtual address of the frame descriptor array, indexed by frame number
+*///----------------------------------------------------------------------------------------------------------------
+#define FRAME_DESC_ADDR 0xffffd20000000000
+
+
+
 /********************************************************************************************************************
 *   Some flags used for mapping pages in the kernel
 *///-----------------------------------------------------------------------------------------------------------------
@@ -188,6 +346,19 @@ enum {
   PG_DEV = 0x00000002, //!< VMM page is not cacheable and it supervisor
   PG_KRN = 0x00000004, //!< VMM Page is supervisor and is not swapable (but may
                        //!< be not present)
+  PG_LOCAL = 0x00000008, //!< VMM page is only used by this CPU; changes are not shot down on other CPUs
+  PG_WC = 0x00000010, //!< VMM page is write-combining (uncached if the CPU has no PAT); for frame buffers
+};
+
+
+
+/********************************************************************************************************************
+*   The bits of the error code pushed by a page fault
+*///-----------------------------------------------------------------------------------------------------------------
+enum {
+  PF_PRESENT = 0x00000001, //!< The page was present; the fault is a protection violation
+  PF_WRITE = 0x00000002, //!< The faulting access was a write
+  PF_USER = 0x00000004, //!< The faulting access was made in user mode
 };
 
 
@@ -365,8 +536,6 @@ typedef struct Tss_t {
   uint32_t upperRsp1;               //!< Upper Stack Pointer to use when interrupting from ring 1
   uint32_t lowerRsp2;               //!< Lower Stack Pointer to use when interrupting from ring 2
   uint32_t upperRsp2;               //!< Upper Stack Pointer to use when interrupting from ring 2
-  uint32_t lowerRsp3;               //!< Lower Stack Pointer to use when interrupting from ring 3
-  uint32_t upperRsp3;               //!< Upper Stack Pointer to use when interrupting from ring 2
   uint32_t reserved1;               //!< Unused
   uint32_t reserved2;               //!< Unused
   uint32_t lowerIst1;               //!< Lower Stack Pointer to use when IST1 is specified
@@ -389,6 +558,19 @@ typedef struct Tss_t {
   uint16_t ioMapBase;               //!< Base offset to the start of the I/O permissions map
 } PACKED Tss_t;
 
+static_assert(sizeof(Tss_t) == 104, "`Tss_t` must match the hardware layout");
+
+
+
+/****************************************************************************************************************//**
+*   @def                GDT_ENTRIES
+*   @brief              The number of entries in each CPU's GDT
+*
+*   The layout is the one of `gdtFinal` in `entry.s`: the shared code and data segments, then this CPU's `gs`
+*   segment at 0x98 and its TSS at 0xa0 (2 entries).
+*///----------------------------------------------------------------------------------------------------------------
+#define GDT_ENTRIES 22
+
 
 
 /****************************************************************************************************************//**
@@ -402,6 +584,7 @@ typedef struct Tss_t {
 *   This structure is dictated by the abstractions required by the x86_64 CPU architecture.
 *///----------------------------------------------------------------------------------------------------------------
 typedef struct ArchCpu_t {
+  uint64_t gdt[GDT_ENTRIES];        //!< This CPU's own GDT
   Tss_t tss;                        //!< This is the x86_64 TSS
 } ArchCpu_t;
 
@@ -467,6 +650,64 @@ PageEntry_t *GetPtEntry(Addr_t a) {
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuInit(void)
+*   @brief              Determine which page sizes and memory types the MMU supports
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void ArchMmuInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuCpuOnline(void)
+*   @brief              Program this CPU's Page Attribute Table so that \ref PG_WC selects write-combining
+*
+*   Called on each CPU after \ref ArchMmuInit has run on the BSP, and before any `PG_WC` mapping is used there.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuCpuOnline(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuShareKernel(void)
+*   @brief              Create a PDPT for every PML4 entry in the kernel half of the address space
+*
+*   The kernel's PML4 entries are copied into each new address space when it is created, so they must all exist
+*   beforehand for later kernel mappings to be seen in every address space.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void ArchMmuShareKernel(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool ArchMmuTableIdle(void)
+*   @brief              Top up this CPU's cache of zeroed paging tables by one from the PMM's pool of zeroed frames
+*
+*   Called from the idle loop.
+*
+*   @returns            Whether a table was added to the cache
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool ArchMmuTableIdle(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t ArchMmuNewSpace(void)
+*   @brief              Allocate and build the top-level paging table for a new address space
+*
+*   The lower half is empty, the upper half is shared with the kernel and the last entry maps the table itself.
+*
+*   @returns            The frame holding the new PML4; 0 if there is no memory
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t ArchMmuNewSpace(void);
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void ArchMmuMapPage(Addr_t a, Frame_t f, int flags)
 *   @brief              Map a page in Virtual Memory Space to a Physical Frame
@@ -480,6 +721,91 @@ void ArchMmuMapPage(Addr_t a, Frame_t f, int flags);
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 bool ArchMmuIsMapped(Addr_t a)
+*   @brief              Determine if an address is mapped to a frame
+*
+*   @param              a                   The address to check
+*
+*   @returns            Whether the page containing `a` is mapped
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool ArchMmuIsMapped(Addr_t a);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuUnmapPage(Addr_t a)
+*   @brief              Remove the mapping for a page in Virtual Memory Space; the frame is not freed
+*
+*   @param              a                   The address to unmap
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuUnmapPage(Addr_t a);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuMapRange(Addr_t a, Frame_t f, size_t count, int flags)
+*   @brief              Map a run of pages to a run of contiguous frames
+*
+*   The tables are walked once for each page table touched and any stale translations are invalidated together
+*   once all the entries are written.  Where the alignment of both addresses and the remaining length allow, and
+*   no page table is already in the way, 2M and (when the CPU supports them) 1G pages are used.  A large page which
+*   is partly remapped or unmapped later is split.
+*
+*   @param              a                   The address of the first page
+*   @param              f                   The first frame
+*   @param              count               The number of pages
+*   @param              flags               Flags which will help control the mapping security
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuMapRange(Addr_t a, Frame_t f, size_t count, int flags);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuUnmapRange(Addr_t a, size_t count)
+*   @brief              Remove the mappings for a run of pages, with a single invalidation for the run
+*
+*   Paging tables left empty are returned to the PMM once the TLB has been flushed.
+*
+*   @param              a                   The address of the first page
+*   @param              count               The number of pages
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuUnmapRange(Addr_t a, size_t count);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuUnmapRangeDeferred(Addr_t a, size_t count, struct TlbBatch_t *batch)
+*   @brief              Remove the mappings for a run of pages, leaving the invalidations queued in the caller's batch
+*
+*   No paging tables are freed.  The old translations may still be cached until the caller flushes the batch.
+*
+*   @param              a                   The address of the first page
+*   @param              count               The number of pages
+*   @param              batch               The batch which will invalidate the old translations
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuUnmapRangeDeferred(Addr_t a, size_t count, struct TlbBatch_t *batch);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t ArchMmuVirtToPhys(Addr_t a)
+*   @brief              Translate a virtual address by walking the paging tables
+*
+*   @param              a                   The virtual address
+*
+*   @returns            The physical address mapped at `a`; 0 if `a` is not mapped
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Addr_t ArchMmuVirtToPhys(Addr_t a);
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 uint8_t INB(uint16_t port)
 *   @brief              Get a byte from an I/O Port
@@ -508,6 +834,89 @@ void INVLPG(Addr_t a) {
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void FlushTlbAll(void)
+*   @brief              Invalidate the entire TLB on this CPU, including global pages
+*
+*   Toggling CR4.PGE drops every TLB entry for every PCID, where reloading CR3 would keep the global ones.
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void FlushTlbAll(void) {
+    Addr_t cr4;
+    __asm volatile("mov %%cr4,%0" : "=r"(cr4));
+    __asm volatile("mov %0,%%cr4" :: "r"(cr4 & ~(Addr_t)0x80) : "memory");
+    __asm volatile("mov %0,%%cr4" :: "r"(cr4) : "memory");
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t GetCr3(void)
+*   @brief              Read the CR3 register, which holds the physical address of the active PML4
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Addr_t GetCr3(void) {
+    Addr_t rv;
+    __asm volatile("mov %%cr3,%0" : "=r"(rv));
+    return rv;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SetCr3(Addr_t cr3)
+*   @brief              Write the CR3 register, switching to another top-level paging table (and PCID)
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void SetCr3(Addr_t cr3) {
+    __asm volatile("mov %0,%%cr3" :: "r"(cr3) : "memory");
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t GetCr4(void)
+*   @brief              Read the CR4 register
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Addr_t GetCr4(void) {
+    Addr_t rv;
+    __asm volatile("mov %%cr4,%0" : "=r"(rv));
+    return rv;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SetCr4(Addr_t cr4)
+*   @brief              Write the CR4 register
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void SetCr4(Addr_t cr4) {
+    __asm volatile("mov %0,%%cr4" :: "r"(cr4) : "memory");
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void LGDT(uint64_t *gdt, uint16_t limit)
+*   @brief              Load the GDT register
+*
+*   @param              gdt                 The first entry of the GDT
+*   @param              limit               The size of the GDT in bytes, less 1
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void LGDT(uint64_t *gdt, uint16_t limit) {
+    struct {
+        uint16_t limit;
+        uint64_t base;
+    } PACKED gdtr = { limit, (uint64_t)gdt };
+
+    __asm volatile("lgdt %0" :: "m"(gdtr) : "memory");
+}
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void LTR(uint16_t tr)
 *   @brief              Load the task register
@@ -542,6 +951,15 @@ void OUTB(uint16_t port, uint8_t val) {
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void PAUSE(void)
+*   @brief              Hint to the CPU that we are in a spin-wait loop
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void PAUSE(void) { __asm volatile("pause" ::: "memory"); }
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void EnableInterrupts(void)
 *   @brief              Enable Interrupts explicitly
@@ -553,6 +971,34 @@ void EnableInterrupts(void) {
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 Addr_t DisableInterrupts(void)
+*   @brief              Disable interrupts and report the flags as they were before
+*
+*   @returns            The `rflags` register before interrupts were disabled; pass to \ref RestoreInterrupts
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Addr_t DisableInterrupts(void) {
+    Addr_t flags;
+    __asm volatile("pushfq\n" "cli\n" "pop %0" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void RestoreInterrupts(Addr_t flags)
+*   @brief              Re-enable interrupts if they were enabled when \ref DisableInterrupts was called
+*
+*   @param              flags               The flags returned from \ref DisableInterrupts
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void RestoreInterrupts(Addr_t flags) {
+    if (flags & 0x200) EnableInterrupts();
+}
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void SWAPGS(void)
 *   @brief              Swap the `gs` register with the IA32_KERNEL_GS_BASE model-specific register (setting limits)
@@ -564,6 +1010,44 @@ void SWAPGS(void) {
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void MOVNTI(uint64_t *p, uint64_t v)
+*   @brief              Store a value with a non-temporal hint so that it does not pollute the cache
+*
+*   @param              p                   The location to store
+*   @param              v                   The value to store
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void MOVNTI(uint64_t *p, uint64_t v) {
+    __asm volatile("movnti %1,%0" : "=m"(*p) : "r"(v));
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SFENCE(void)
+*   @brief              Order all prior stores (including non-temporal stores) before any later store
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void SFENCE(void) {
+    __asm volatile("sfence" ::: "memory");
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t RDTSC(void)
+*   @brief              Read the Time Stamp Counter
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint64_t RDTSC(void) {
+    uint32_t lo, hi;
+    __asm volatile("rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void WBNOINVD(void)
 *   @brief              Synchronize the cpu caches
@@ -575,6 +1059,41 @@ void WBNOINVD(void) {
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void MONITOR(volatile void *p)
+*   @brief              Arm address monitoring on the cache line holding an address, for a following \ref MWAIT
+*
+*   @param              p                   An address in the line to monitor
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void MONITOR(volatile void *p) {
+    __asm volatile("monitor" :: "a"(p), "c"(0), "d"(0) : "memory");
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void MWAIT(void)
+*   @brief              Sleep until the line armed by \ref MONITOR is written or an interrupt arrives
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void MWAIT(void) {
+    __asm volatile("mwait" :: "a"(0), "c"(0) : "memory");
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void HLT(void)
+*   @brief              Halt the CPU until the next interrupt
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void HLT(void) {
+    __asm volatile("hlt" ::: "memory");
+}
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void int00(void)
 *   @brief              Handle the \#DE Fault
@@ -872,6 +1391,15 @@ void int20(void);
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void intf0(void)
+*   @brief              TLB shootdown IPI
+*///-----------------------------------------------------------------------------------------------------------------
+LZONE_FUNC
+void intf0(void);
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void intxx(void)
 *   @brief              Generically handle any other IRQ or software generated interrupt
@@ -905,7 +1433,7 @@ void IdtSetHandler(int i, uint16_t sel, Addr_t handler, int ist, int dpl);
 *   @fn                 void ArchEarlyInit(void)
 *   @brief              Complete the early initialization tasks for the x86_64 arch
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void ArchEarlyInit(void);
 
 
@@ -921,12 +1449,43 @@ void ArchApInit(void);
 /****************************************************************************************************************//**
 *   @fn                 void MoveTrampoline(void)
 *   @brief              Move the trampoline code the its target location in 16-bit real mode address space
+*
+*   Then start all the APs at once: the trampoline gets the APIC ID of each CPU so an AP can find its CPU number
+*   and its stack, the INIT and SIPI IPIs are sent to every AP in turn, and this returns once every AP has reached
+*   \ref kInitAp.
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void MoveTrampoline(void);
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 int ArchCacheColors(void)
+*   @brief              Determine the number of page colors of the outermost data cache
+*
+*   The number of colors is the size of one way of the cache divided by the page size: frames whose numbers are
+*   equal modulo this count compete for the same cache sets.  The CPUID deterministic cache parameters (leaf 4)
+*   are used when available, falling back to the extended L2/L3 leaf (0x80000006).
+*
+*   @returns            The number of page colors, a power of 2; 1 if it cannot be determined
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+int ArchCacheColors(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchReleaseBootMemory(void)
+*   @brief              Return the arch-specific boot-only memory to the PMM and remove the identity map
+*
+*   This releases the AP trampoline, the `.smptext` section, the `.entry` section (the Multiboot header, the 32-bit
+*   boot code and its GDT) and the temporary IDT.  It must not be called until all the APs have started.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchReleaseBootMemory(void);
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void kInitAp(void)
 *   @brief              Perform the initialization of the AP, prearing them for the kernel
@@ -996,7 +1555,7 @@ void LapicInit(void);
 *
 *   Send an INIT IPI to a core
 *
-*   @param              core                The core to receive the INIT IPI
+*   @param              core                The CPU number of the core to receive the INIT IPI
 *///-----------------------------------------------------------------------------------------------------------------
 KRN_FUNC
 void LapicSendInit(int core);
@@ -1009,7 +1568,7 @@ void LapicSendInit(int core);
 *
 *   Send an Startup IPI to a core
 *
-*   @param              core                The core to receive the INIT IPI
+*   @param              core                The CPU number of the core to receive the Startup IPI
 *   @param              vector              The segment register (offset 0x0000) to set for the startup location
 *///-----------------------------------------------------------------------------------------------------------------
 KRN_FUNC
@@ -1017,11 +1576,37 @@ void LapicSendSipi(int core, Addr_t vector);
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void LapicSendIpi(int core, int vector)
+*   @brief              Send a fixed interrupt to another core
+*
+*   @param              core                The CPU number of the core to receive the IPI
+*   @param              vector              The interrupt vector to raise on that core
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void LapicSendIpi(int core, int vector);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PitDelay(uint32_t micros)
+*   @brief              Busy-wait for a time, measured with PIT channel 2
+*
+*   This does not need interrupts or a calibrated TSC, so it can be used during CPU startup.  Only one CPU may use
+*   it at a time.
+*
+*   @param              micros              The number of microseconds to wait
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PitDelay(uint32_t micros);
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 int LapicGetId(void)
 *   @brief              Read the Local APIC ID
 *
-*   Read the Local APIC ID, equivalent to the CPU number
+*   Read the Local APIC ID; \ref CpuFromApicId turns it into the CPU number
 *
 *   @returns            Local APIC ID
 *///-----------------------------------------------------------------------------------------------------------------
@@ -1034,7 +1619,7 @@ int LapicGetId(void);
 *   @fn                 void PlatformDiscovery(void)
 *   @brief              Complete the hardware discovery for the platform
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void PlatformDiscovery(void);
 
 
@@ -1065,15 +1650,101 @@ void PlatformDiscovery(void);
 
 
 
+/****************************************************************************************************************//**
+*   @typedef            PerCpuType_t
+*   @brief              The type of a per-CPU variable without `volatile`, for the register \ref PerCpuRead and
+*                       \ref PerCpuWrite move it through
+*///-----------------------------------------------------------------------------------------------------------------
+template <typename T> struct PerCpuType_t { typedef T type; };
+template <typename T> struct PerCpuType_t<volatile T> { typedef T type; };
+
+
+
+/****************************************************************************************************************//**
+*   @def                PerCpuRead
+*   @brief              Read this CPU's copy of a scalar per-CPU variable (or member of one) with a single `gs` load
+*
+*   The load is never cached or moved by the compiler, so it may be used to poll.  The variable's offset is passed in
+*   a register rather than as an immediate, which `-mcmodel=large` does not allow for a symbol.
+*///-----------------------------------------------------------------------------------------------------------------
+#define PerCpuRead(var) ({                                                                                          \
+    typename PerCpuType_t<__typeof__(var)>::type __v;                                                               \
+    __asm volatile("mov %%gs:(%1),%0" : "=r"(__v) : "r"((Addr_t)&(var)) : "memory");                                \
+    __v;                                                                                                            \
+})
+
+
+
+/****************************************************************************************************************//**
+*   @def                PerCpuWrite
+*   @brief              Write this CPU's copy of a scalar per-CPU variable (or member of one) with a single `gs` store
+*///-----------------------------------------------------------------------------------------------------------------
+#define PerCpuWrite(var, val) ({                                                                                    \
+    typename PerCpuType_t<__typeof__(var)>::type __v = (val);                                                       \
+    __asm volatile("mov %0,%%gs:(%1)" :: "r"(__v), "r"((Addr_t)&(var)) : "memory");                                 \
+})
+
+
+
+/****************************************************************************************************************//**
+*   @def                PerCpuPtr
+*   @brief              Get the address of a CPU's copy of a per-CPU variable; each CPU's block starts at its \ref Cpu_t
+*///-----------------------------------------------------------------------------------------------------------------
+#define PerCpuPtr(cpu, var)     ((__typeof__(var) *)((Addr_t)cpus[cpu] + (Addr_t)&(var)))
+
+
+
+/****************************************************************************************************************//**
+*   @def                PerCpuThis
+*   @brief              Get the address of this CPU's copy of a per-CPU variable, for members which a single `gs`
+*                       access cannot reach (such as an array element picked at run time)
+*
+*   The pointer is only good on this CPU, so interrupts must stay disabled while it is used.
+*///-----------------------------------------------------------------------------------------------------------------
+#define PerCpuThis(var)         ((__typeof__(var) *)((Addr_t)PerCpuRead(cpuLocal.cpu) + (Addr_t)&(var)))
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Cpu_t *ThisCpu(void)
+*   @brief              Get the \ref Cpu_t structure for this cpu
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Cpu_t *ThisCpu(void) {
+    return PerCpuRead(cpuLocal.cpu);
+}
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 int ThisCpuNum(void)
 *   @brief              This this cpu's number
 *///-----------------------------------------------------------------------------------------------------------------
 INLINE
 int ThisCpuNum(void) {
-    Cpu_t *c;
-    __asm volatile("mov %%gs:(8),%0" : "=r"(c) :: "memory");
-    return c->cpuNumber;
+    return PerCpuRead(cpuLocal.cpuNumber);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t *ArchMmuTableWindow(Frame_t t)
+*   @brief              Reach the entries of a paging table which is not installed, through this CPU's MMU scratch page
+*
+*   The page table holding the scratch pages always exists and each CPU only writes its own entry, so this never
+*   walks or allocates tables.  Interrupts must be disabled until the caller is done with the table.
+*
+*   @param              t                   The frame holding the table
+*
+*   @returns            The address of the table's entries
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint64_t *ArchMmuTableWindow(Frame_t t) {
+    Addr_t win = MMU_SCRATCH_ADDR + (ThisCpuNum() * PAGE_SIZE);
+
+    *(uint64_t *)GetPtEntry(win) = ((uint64_t)t << 12) | 0x03;
+    INVLPG(win);
+    return (uint64_t *)win;
 }
 
 
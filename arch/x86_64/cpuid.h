@@ -51,6 +51,26 @@ void CPUID(int code, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void CPUIDEX(int code, int sub, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d)
+*   @brief              Use the CPUID instruction to retrieve a sub-leaf of system capabilities
+*
+*   Some leaves (such as 4, the deterministic cache parameters) take a sub-leaf index in ecx.
+*
+*   @param              code                Which CPUID code on which to poll capabilities
+*   @param              sub                 The sub-leaf index
+*   @param              a                   Where to store the contents of the eax register
+*   @param              b                   Where to store the contents of the ebx register
+*   @param              c                   Where to store the contents of the ecx register
+*   @param              d                   Where to store the contents of the edx register
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void CPUIDEX(int code, int sub, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm volatile("cpuid" : "=a"(*a),"=b"(*b),"=c"(*c),"=d"(*d) : "a"(code),"c"(sub) : "memory");
+}
+
+
+
 /****************************************************************************************************************//**
 *   @var                CPUID_FEAT_ECX_SSE3
 *   @brief              The CPU supports SSE3
@@ -522,5 +542,39 @@ const uint64_t CPUID_FEAT_EDX_TM           = (1<<29);
 const uint64_t CPUID_FEAT_EDX_PBE          = (1<<31);
 
 
+
+/****************************************************************************************************************//**
+*   @var                CPUID_EXT_EDX_PAGE1GB
+*   @brief              The CPU supports 1G pages (leaf 0x80000001)
+*///-----------------------------------------------------------------------------------------------------------------
+const uint64_t CPUID_EXT_EDX_PAGE1GB       = (1<<26);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint32_t CpuidApicId(void)
+*   @brief              Get this CPU's APIC ID without touching the Local APIC
+*
+*   The full 32-bit x2APIC ID comes from leaf 0xb where it is implemented; otherwise the 8-bit initial APIC ID
+*   comes from leaf 1.  The AP trampoline in `entryAp.s` does the same.
+*
+*   @returns            The APIC ID
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint32_t CpuidApicId(void) {
+    uint32_t a, b, c, d;
+
+    CPUID(0, &a, &b, &c, &d);
+
+    if (a >= 0xb) {
+        CPUIDEX(0xb, 0, &a, &b, &c, &d);
+        if (b != 0) return d;
+    }
+
+    CPUID(1, &a, &b, &c, &d);
+    return b >> 24;
+}
+
+
 #endif
 
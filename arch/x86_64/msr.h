@@ -80,6 +80,14 @@ const uint32_t IA32_GS_BASE = 0xc0000101;
 
 
 
+/****************************************************************************************************************//**
+*   @var                IA32_PAT
+*   @brief              MSR location for the Page Attribute Table, which holds the memory type for each PAT index
+*///-----------------------------------------------------------------------------------------------------------------
+const uint32_t IA32_PAT = 0x277;
+
+
+
 #endif
 
 
@@ -0,0 +1,44 @@
+/****************************************************************************************************************//**
+*   @file               addr-space.h
+*   @brief              Host stand-in for the address space interface; the benchmark runs a single address space
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __ADDR_SPACE_H__
+#define __ADDR_SPACE_H__
+
+
+
+#include "arch.h"
+
+
+
+typedef struct AddrSpace_t AddrSpace_t;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 AddrSpace_t *AddrSpaceCurrent(void)
+*   @brief              There is no address space object in the simulation; user mappings use the batch's `nullptr`
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+AddrSpace_t *AddrSpaceCurrent(void) { return nullptr; }
+
+
+
+#endif
@@ -0,0 +1,222 @@
+/****************************************************************************************************************//**
+*   @file               arch.h
+*   @brief              Host stand-in for the x86_64 arch header, for building `arch-mmu.cc` into the MMU benchmark
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   Only what `arch-mmu.cc` uses is provided.  The types and constants match `arch/x86_64/arch.h`; the recursive
+*   mapping is replaced by a walk of the simulated paging tables from the simulated `cr3`, which reaches the same
+*   entries the recursive mapping would.  Privileged instructions do nothing or report a fixed CPU.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __ARCH_H__
+#define __ARCH_H__
+
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+/********************************************************************************************************************
+*   The compiler decorations from the kernel; on the host there are no special sections
+*///-----------------------------------------------------------------------------------------------------------------
+#define EXTERNC         extern "C"
+#define INLINE          inline __attribute__((always_inline))
+#define PACKED          __attribute__((packed))
+#define KRN_FUNC        EXTERNC
+#define INIT_FUNC       EXTERNC
+#define KERNEL_BSS
+#define KERNEL_RODATA
+#define PER_CPU
+
+
+
+/********************************************************************************************************************
+*   The constants `arch-mmu.cc` needs, with the kernel's values
+*///-----------------------------------------------------------------------------------------------------------------
+#define MAX_CPU                 256
+#define PAGE_SIZE               4096
+#define USER_SPACE_END          0x0000800000000000
+#define MMU_SCRATCH_ADDR        0xffffd18000000000
+
+
+
+/********************************************************************************************************************
+*   Some flags used for mapping pages in the kernel
+*///-----------------------------------------------------------------------------------------------------------------
+enum {
+  PG_WRT = 0x00000001, //!< VMM page is writable
+  PG_DEV = 0x00000002, //!< VMM page is not cacheable and it supervisor
+  PG_KRN = 0x00000004, //!< VMM Page is supervisor and is not swapable (but may be not present)
+  PG_LOCAL = 0x00000008, //!< VMM page is only used by this CPU; changes are not shot down on other CPUs
+  PG_WC = 0x00000010, //!< VMM page is write-combining (uncached if the CPU has no PAT); for frame buffers
+};
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            Addr_t
+*   @brief              An address, virtual or physical
+*///-----------------------------------------------------------------------------------------------------------------
+typedef uint64_t Addr_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            Frame_t
+*   @brief              A frame number
+*///-----------------------------------------------------------------------------------------------------------------
+typedef uint64_t Frame_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            PageEntry_t
+*   @brief              Formalization of the \ref PageEntry_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             PageEntry_t
+*   @brief              The structure of the x86_64-pc page table Entry
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct PageEntry_t {
+  unsigned int p : 1;               //!< Is the page present?
+  unsigned int rw : 1;              //!< set to 1 to allow writes
+  unsigned int us : 1;              //!< 0=Supervisor; 1=user
+  unsigned int pwt : 1;             //!< Page Write Through
+  unsigned int pcd : 1;             //!< Page-level cache disable
+  unsigned int a : 1;               //!< accessed
+  unsigned int d : 1;               //!< dirty (needs to be written for a swap)
+  unsigned int pat : 1;             //!< set to 0 for tables, page Page Attribute Table (set to 0)
+  unsigned int g : 1;               //!< Global (set to 0)
+  unsigned int k : 1;               //!< Is this a kernel-space (protected) page?
+  unsigned int avl : 2;             //!< Available for software use
+  Frame_t frame : 36;               //!< This is the 4K aligned page frame address (or table address)
+  unsigned int reserved : 4;        //!< reserved bits
+  unsigned int software : 11;       //!< software use bits
+  unsigned int xd : 1;              //!< execute disable
+} PACKED PageEntry_t;
+
+
+
+/********************************************************************************************************************
+*   The CPUID bits `arch-mmu.cc` tests
+*///-----------------------------------------------------------------------------------------------------------------
+const uint64_t CPUID_FEAT_EDX_PAT          = (1<<16);
+const uint64_t CPUID_EXT_EDX_PAGE1GB       = (1<<26);
+const uint32_t IA32_PAT = 0x277;
+
+
+
+/********************************************************************************************************************
+*   The simulated machine; see `sim.cc`
+*///-----------------------------------------------------------------------------------------------------------------
+extern Addr_t simCr3;
+extern bool simHas1G;
+extern uint64_t simPat;
+extern uint64_t simTableDummy[512];
+
+EXTERNC uint64_t *SimTable(Frame_t f);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 PageEntry_t *SimEntry(Addr_t a, int level)
+*   @brief              Find the entry the recursive mapping would show for an address at a level (0 = PML4, 3 = PT)
+*
+*   Where the recursive mapping would fault or reach into a large page, a scratch table of zeros is returned
+*   instead; `arch-mmu.cc` never reads through such an entry.
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+PageEntry_t *SimEntry(Addr_t a, int level) {
+    uint64_t *tbl = SimTable(simCr3 >> 12);
+
+    for (int l = 0; l < level; l ++) {
+        uint64_t e = tbl[(a >> (39 - (9 * l))) & 0x1ff];
+
+        if (!(e & 0x01) || (e & 0x80)) return (PageEntry_t *)&simTableDummy[(a >> (39 - (9 * level))) & 0x1ff];
+        tbl = SimTable((e & 0x000ffffffffff000) >> 12);
+    }
+
+    return (PageEntry_t *)&tbl[(a >> (39 - (9 * level))) & 0x1ff];
+}
+
+
+
+INLINE PageEntry_t *GetPml4Entry(Addr_t a) { return SimEntry(a, 0); }
+INLINE PageEntry_t *GetPdptEntry(Addr_t a) { return SimEntry(a, 1); }
+INLINE PageEntry_t *GetPdEntry(Addr_t a) { return SimEntry(a, 2); }
+INLINE PageEntry_t *GetPtEntry(Addr_t a) { return SimEntry(a, 3); }
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t *ArchMmuTableWindow(Frame_t t)
+*   @brief              Reach a table which is not installed; the simulated physical memory is always reachable
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint64_t *ArchMmuTableWindow(Frame_t t) { return SimTable(t); }
+
+
+
+/********************************************************************************************************************
+*   The privileged instructions, simulated for a single CPU with interrupts which never arrive
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE Addr_t GetCr3(void) { return simCr3; }
+INLINE void INVLPG(Addr_t) {}
+INLINE Addr_t DisableInterrupts(void) { return 0; }
+INLINE void RestoreInterrupts(Addr_t) {}
+INLINE void PAUSE(void) {}
+INLINE int ThisCpuNum(void) { return 0; }
+
+#define PerCpuRead(var)         (var)
+#define PerCpuWrite(var, val)   ((var) = (val))
+#define PerCpuThis(var)         (&(var))
+INLINE uint64_t RDMSR(uint32_t) { return simPat; }
+INLINE void WRMSR(uint32_t, uint64_t v) { simPat = v; }
+
+INLINE
+void CPUID(int code, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    *a = *b = *c = *d = 0;
+
+    if (code == 1) *d = CPUID_FEAT_EDX_PAT;
+    else if (code == (int)0x80000000) *a = 0x80000001;
+    else if (code == (int)0x80000001) *d = (simHas1G ? CPUID_EXT_EDX_PAGE1GB : 0);
+}
+
+
+
+/********************************************************************************************************************
+*   The MMU interface implemented by `arch-mmu.cc`
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC void ArchMmuInit(void);
+KRN_FUNC void ArchMmuCpuOnline(void);
+INIT_FUNC void ArchMmuShareKernel(void);
+KRN_FUNC bool ArchMmuTableIdle(void);
+KRN_FUNC Frame_t ArchMmuNewSpace(void);
+KRN_FUNC void ArchMmuMapPage(Addr_t a, Frame_t f, int flags);
+KRN_FUNC bool ArchMmuIsMapped(Addr_t a);
+KRN_FUNC void ArchMmuUnmapPage(Addr_t a);
+KRN_FUNC void ArchMmuMapRange(Addr_t a, Frame_t f, size_t count, int flags);
+KRN_FUNC void ArchMmuUnmapRange(Addr_t a, size_t count);
+KRN_FUNC void ArchMmuUnmapRangeDeferred(Addr_t a, size_t count, struct TlbBatch_t *batch);
+KRN_FUNC Addr_t ArchMmuVirtToPhys(Addr_t a);
+
+
+
+#endif
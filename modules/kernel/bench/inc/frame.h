@@ -0,0 +1,53 @@
+/****************************************************************************************************************//**
+*   @file               frame.h
+*   @brief              Host stand-in for the frame descriptors, tracking the owner of each simulated frame
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            FrameDesc_t
+*   @brief              Formalization of the \ref FrameDesc_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             FrameDesc_t
+*   @brief              The part of a frame descriptor `arch-mmu.cc` reads
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct FrameDesc_t {
+    int owner;                                  //!< The PMM tag the frame was allocated under
+} FrameDesc_t;
+
+
+
+/********************************************************************************************************************
+*   The simulated frame descriptors; see `sim.cc`
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC bool FrameIsAvailable(Frame_t f);
+EXTERNC FrameDesc_t *FrameGetDesc(Frame_t f);
+
+
+
+#endif
@@ -0,0 +1,39 @@
+/****************************************************************************************************************//**
+*   @file               internals.h
+*   @brief              Host stand-in for the kernel internals: debug output and panics go to the terminal
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __INTERNALS_H__
+#define __INTERNALS_H__
+
+
+
+#include "arch.h"
+
+
+
+EXTERNC __attribute__((format(printf,1,2)))
+int DbgPrintf(const char *fmt, ...);
+
+EXTERNC __attribute__((noreturn))
+void KernelPanic(const char *msg);
+
+
+
+#endif
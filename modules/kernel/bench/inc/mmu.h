@@ -0,0 +1,42 @@
+/****************************************************************************************************************//**
+*   @file               mmu.h
+*   @brief              Host stand-in for the MMU interface: the direct map is the simulated physical memory
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __MMU_H__
+#define __MMU_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t PhysToVirt(Addr_t p)
+*   @brief              Reach a simulated physical address
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Addr_t PhysToVirt(Addr_t p) {
+    return (Addr_t)SimTable(p >> 12) + (p & (PAGE_SIZE - 1));
+}
+
+
+
+#endif
@@ -0,0 +1,50 @@
+/****************************************************************************************************************//**
+*   @file               pmm.h
+*   @brief              Host stand-in for the PMM, handing out frames of the simulated physical memory
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __PMM_H__
+#define __PMM_H__
+
+
+
+#include "arch.h"
+
+
+
+/********************************************************************************************************************
+*   The allocation-site tags, with the kernel's values
+*///-----------------------------------------------------------------------------------------------------------------
+typedef enum {
+    PMM_TAG_NONE = 0,                   //!< Untagged
+    PMM_TAG_PGTABLE = 3,                //!< Paging tables
+} PmmTag_t;
+
+
+
+/********************************************************************************************************************
+*   The simulated PMM; see `sim.cc`.  Every frame it hands out is filled with zeros.
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC Frame_t PmmAllocate(PmmTag_t tag);
+EXTERNC Frame_t PmmAllocateZeroed(PmmTag_t tag);
+EXTERNC void PmmFree(Frame_t f);
+
+
+
+#endif
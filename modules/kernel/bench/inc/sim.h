@@ -0,0 +1,84 @@
+/****************************************************************************************************************//**
+*   @file               sim.h
+*   @brief              The simulated machine the MMU benchmark runs `arch-mmu.cc` on
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            SimStats_t
+*   @brief              Formalization of the \ref SimStats_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             SimStats_t
+*   @brief              What the simulated machine has counted
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct SimStats_t {
+    uint64_t tables;                            //!< The frames allocated now (paging tables and cached tables)
+    uint64_t peak;                              //!< The most frames allocated at once
+    uint64_t flushes;                           //!< The number of TLB flushes requested
+    uint64_t fullFlushes;                       //!< The number of those which flushed the whole TLB
+} SimStats_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                simStats
+*   @brief              The counters, reset with \ref SimResetStats
+*///-----------------------------------------------------------------------------------------------------------------
+extern SimStats_t simStats;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SimInit(size_t frames)
+*   @brief              Create the simulated physical memory and an empty top-level table to run in
+*
+*   @param              frames              The number of frames of physical memory, all available for tables
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC void SimInit(size_t frames);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SimResetStats(void)
+*   @brief              Zero the flush counters and restart the peak from the current allocation
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC void SimResetStats(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SimCheck(void)
+*   @brief              Check that every free frame is filled with zeros
+*
+*   Frames are never cleared by the simulation, so this holds only if the MMU frees nothing but empty tables.
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC void SimCheck(void);
+
+
+
+#endif
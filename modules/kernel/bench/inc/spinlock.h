@@ -0,0 +1,47 @@
+/****************************************************************************************************************//**
+*   @file               spinlock.h
+*   @brief              Host stand-in for the kernel spinlocks; the simulated machine has a single CPU
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __SPINLOCK_H__
+#define __SPINLOCK_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            Spinlock_t
+*   @brief              A spinlock, which is always available to the only CPU
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct Spinlock_t {
+    volatile int lock;                          //!< 0 when the lock is available; 1 when it is held
+} Spinlock_t;
+
+
+
+INLINE void SpinLock(Spinlock_t *l) { l->lock = 1; }
+INLINE bool SpinTryLock(Spinlock_t *l) { l->lock = 1; return true; }
+INLINE void SpinUnlock(Spinlock_t *l) { l->lock = 0; }
+
+
+
+#endif
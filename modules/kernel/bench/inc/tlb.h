@@ -0,0 +1,88 @@
+/****************************************************************************************************************//**
+*   @file               tlb.h
+*   @brief              Host stand-in for TLB shootdowns, which are only counted
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __TLB_H__
+#define __TLB_H__
+
+
+
+#include "arch.h"
+#include "addr-space.h"
+
+
+
+#define TLB_BATCH_MAX           32
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            TlbBatch_t
+*   @brief              Formalization of the \ref TlbBatch_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             TlbBatch_t
+*   @brief              A set of pending invalidations, as in the kernel
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct TlbBatch_t {
+    AddrSpace_t *space;                         //!< The address space; `nullptr` for the kernel
+    int count;                                  //!< The number of pages queued
+    bool full;                                  //!< Too many pages were queued; flush the whole TLB
+    Addr_t addr[TLB_BATCH_MAX];                 //!< The pages to invalidate
+} TlbBatch_t;
+
+
+
+INLINE
+void TlbBatchInit(TlbBatch_t *b, AddrSpace_t *space) {
+    b->space = space;
+    b->count = 0;
+    b->full = false;
+}
+
+
+
+INLINE
+void TlbQueue(TlbBatch_t *b, Addr_t a) {
+    if (b->full) return;
+
+    if (b->count == TLB_BATCH_MAX) b->full = true;
+    else b->addr[b->count ++] = a;
+}
+
+
+
+INLINE
+void TlbQueueAll(TlbBatch_t *b) {
+    b->full = true;
+}
+
+
+
+/********************************************************************************************************************
+*   The simulated flushes; see `sim.cc`
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC void TlbFlush(TlbBatch_t *b);
+EXTERNC void TlbFlushLocal(TlbBatch_t *b);
+INLINE void TlbService(void) {}
+
+
+
+#endif
@@ -0,0 +1,214 @@
+/****************************************************************************************************************//**
+*   @file               mmu-bench.cc
+*   @brief              Measure the MMU code on the host, against a simulated physical memory
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   Built and run with `make bench-mmu`.  Each pattern maps and then unmaps a set of pages in the user half of
+*   the simulated address space.  It reports the pages mapped and unmapped per second, the most paging tables in
+*   use at once, and the tables still in use afterwards (the top-level table plus any held in the per-CPU table
+*   cache).
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include <stdio.h>
+#include <time.h>
+
+#include "arch.h"
+#include "internals.h"
+#include "sim.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                BENCH_FRAMES
+*   @brief              The size of the simulated physical memory, in frames (256M)
+*///-----------------------------------------------------------------------------------------------------------------
+#define BENCH_FRAMES        (64 * 1024)
+
+
+
+/****************************************************************************************************************//**
+*   @def                BENCH_BASE
+*   @brief              Where the patterns start mapping, in the user half
+*///-----------------------------------------------------------------------------------------------------------------
+#define BENCH_BASE          0x0000010000000000
+
+
+
+/****************************************************************************************************************//**
+*   @def                BENCH_1G
+*   @brief              The number of bytes covered by a PDPT entry
+*///-----------------------------------------------------------------------------------------------------------------
+#define BENCH_1G            ((Addr_t)1 << 30)
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 double Now(void)
+*   @brief              The current time in seconds
+*///-----------------------------------------------------------------------------------------------------------------
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void Report(const char *name, size_t ops, size_t pages, bool perCall, double map,
+*                               double unmap)
+*   @brief              Print the results of one pattern and check that it left nothing mapped and no tables dirty
+*
+*   @param              name                The name of the pattern
+*   @param              ops                 The number of map calls (and of unmap calls)
+*   @param              pages               The number of 4K pages covered
+*   @param              perCall             Report the rates in calls/s rather than 4K pages/s
+*   @param              map                 The seconds spent mapping
+*   @param              unmap               The seconds spent unmapping
+*///-----------------------------------------------------------------------------------------------------------------
+static void Report(const char *name, size_t ops, size_t pages, bool perCall, double map, double unmap)
+{
+    double units = perCall ? ops : pages;
+
+    printf("%-22s %8zu %10zu %14.0f %14.0f %5s %8lu %6lu %8lu\n", name, ops, pages, units / map, units / unmap,
+            perCall ? "call" : "pg", (unsigned long)simStats.peak, (unsigned long)simStats.tables,
+            (unsigned long)simStats.flushes);
+
+    if (ArchMmuIsMapped(BENCH_BASE)) KernelPanic("A pattern left pages mapped");
+    SimCheck();
+    SimResetStats();
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void BenchSequential(size_t count)
+*   @brief              Map a run of pages one call at a time, with scattered frames so only 4K pages are used
+*///-----------------------------------------------------------------------------------------------------------------
+static void BenchSequential(size_t count)
+{
+    double start = Now();
+
+    for (size_t i = 0; i < count; i ++) {
+        ArchMmuMapPage(BENCH_BASE + (i * PAGE_SIZE), 0x100000 + ((i * 7919) % 1000003), PG_WRT);
+    }
+
+    double map = Now() - start;
+    start = Now();
+
+    for (size_t i = 0; i < count; i ++) ArchMmuUnmapPage(BENCH_BASE + (i * PAGE_SIZE));
+
+    Report("sequential, 4K calls", count, count, false, map, Now() - start);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void BenchRange(size_t count)
+*   @brief              Map the same run with a single call; the frames are contiguous but misaligned for large pages
+*///-----------------------------------------------------------------------------------------------------------------
+static void BenchRange(size_t count)
+{
+    double start = Now();
+
+    ArchMmuMapRange(BENCH_BASE, 0x100001, count, PG_WRT);
+
+    double map = Now() - start;
+    start = Now();
+
+    ArchMmuUnmapRange(BENCH_BASE, count);
+
+    Report("sequential, one range", 1, count, false, map, Now() - start);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void BenchSparse(size_t count)
+*   @brief              Map single pages 1G + 2M + 4K apart, so each one needs its own page directory and page table
+*///-----------------------------------------------------------------------------------------------------------------
+static void BenchSparse(size_t count)
+{
+    const Addr_t stride = BENCH_1G + (2 << 20) + PAGE_SIZE;
+    double start = Now();
+
+    for (size_t i = 0; i < count; i ++) ArchMmuMapPage(BENCH_BASE + (i * stride), 0x100000 + i, PG_WRT);
+
+    double map = Now() - start;
+    start = Now();
+
+    for (size_t i = 0; i < count; i ++) ArchMmuUnmapPage(BENCH_BASE + (i * stride));
+
+    Report("sparse", count, count, false, map, Now() - start);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void BenchLarge(const char *name, size_t count)
+*   @brief              Map 1G ranges of 1G-aligned frames, which use 1G or 2M pages depending on the simulated CPU
+*
+*   A large page is one table entry however many 4K pages it covers, so this pattern is reported per call.
+*///-----------------------------------------------------------------------------------------------------------------
+static void BenchLarge(const char *name, size_t count)
+{
+    const size_t pages = BENCH_1G / PAGE_SIZE;
+    double start = Now();
+
+    for (size_t i = 0; i < count; i ++) ArchMmuMapRange(BENCH_BASE + (i * BENCH_1G), (i + 1) * pages, pages, PG_WRT);
+
+    double map = Now() - start;
+    start = Now();
+
+    for (size_t i = 0; i < count; i ++) ArchMmuUnmapRange(BENCH_BASE + (i * BENCH_1G), pages);
+
+    Report(name, count, count * pages, true, map, Now() - start);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 int main(void)
+*   @brief              Run each pattern in turn on one simulated machine
+*
+*   The patterns share the simulated memory and the top-level table; `Report()` checks that each one leaves nothing
+*   mapped and no tables behind, so the next starts from the same clean state.  The 2M-page row re-runs
+*   `ArchMmuInit()` so that it sees the simulated CPU without 1G page support.
+*///-----------------------------------------------------------------------------------------------------------------
+int main(void)
+{
+    SimInit(BENCH_FRAMES);
+    ArchMmuInit();
+
+    printf("%-22s %8s %10s %14s %14s %5s %8s %6s %8s\n", "pattern", "calls", "pages", "map/s", "unmap/s",
+            "unit", "peak-tbl", "left", "flushes");
+
+    BenchSequential(256 * 1024);
+    BenchRange(256 * 1024);
+    BenchSparse(8 * 1024);
+
+    BenchLarge("large, 1G pages", 64);
+
+    simHas1G = false;
+    ArchMmuInit();
+    BenchLarge("large, 2M pages", 64);
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+/****************************************************************************************************************//**
+*   @file               sim.cc
+*   @brief              The simulated machine the MMU benchmark runs `arch-mmu.cc` on
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   Physical memory is a single host allocation; frame `n` is at byte `n * PAGE_SIZE`.  Frame 0 is never handed
+*   out, since the PMM uses it to report failure.  Only paging tables live here: the frames mapped by the
+*   benchmark are just numbers and are never touched.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "frame.h"
+#include "internals.h"
+#include "pmm.h"
+#include "tlb.h"
+#include "sim.h"
+
+
+
+/********************************************************************************************************************
+*   The state of the simulated machine
+*///-----------------------------------------------------------------------------------------------------------------
+Addr_t simCr3;
+bool simHas1G = true;
+uint64_t simPat = 0x0007040600070406;
+uint64_t simTableDummy[512];
+SimStats_t simStats;
+
+static uint64_t *simMemory;
+static size_t simFrames;
+static FrameDesc_t *simDesc;
+static Frame_t *simFree;
+static size_t simFreeCount;
+
+
+
+/********************************************************************************************************************
+*   See documentation in sim.h
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+void SimInit(size_t frames)
+{
+    simMemory = (uint64_t *)aligned_alloc(PAGE_SIZE, frames * PAGE_SIZE);
+    simDesc = (FrameDesc_t *)calloc(frames, sizeof(FrameDesc_t));
+    simFree = (Frame_t *)malloc(frames * sizeof(Frame_t));
+    if (!simMemory || !simDesc || !simFree) KernelPanic("Unable to allocate the simulated physical memory");
+
+    memset(simMemory, 0, frames * PAGE_SIZE);
+    simFrames = frames;
+
+
+    //
+    // -- Hand out the low frames first, as the real PMM tends to
+    //    -------------------------------------------------------
+    simFreeCount = 0;
+    for (Frame_t f = frames - 1; f > 0; f --) simFree[simFreeCount ++] = f;
+
+    simCr3 = PmmAllocate(PMM_TAG_PGTABLE) << 12;
+    SimResetStats();
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in sim.h
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+void SimResetStats(void)
+{
+    simStats.peak = simStats.tables;
+    simStats.flushes = 0;
+    simStats.fullFlushes = 0;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in sim.h
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+void SimCheck(void)
+{
+    for (size_t i = 0; i < simFreeCount; i ++) {
+        uint64_t *t = SimTable(simFree[i]);
+
+        for (int j = 0; j < 512; j ++) {
+            if (t[j]) KernelPanic("A paging table was freed with entries still in it");
+        }
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   The simulated physical memory
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+uint64_t *SimTable(Frame_t f)
+{
+    if (f == 0 || f >= simFrames) KernelPanic("Reference to a frame outside the simulated physical memory");
+    return &simMemory[f * 512];
+}
+
+
+
+/********************************************************************************************************************
+*   The simulated frame descriptors
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+bool FrameIsAvailable(Frame_t f)
+{
+    return f > 0 && f < simFrames;
+}
+
+
+
+EXTERNC
+FrameDesc_t *FrameGetDesc(Frame_t f)
+{
+    return &simDesc[f];
+}
+
+
+
+/********************************************************************************************************************
+*   The simulated PMM
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+Frame_t PmmAllocate(PmmTag_t tag)
+{
+    if (!simFreeCount) return 0;
+
+    Frame_t f = simFree[-- simFreeCount];
+    simDesc[f].owner = tag;
+
+    if (++ simStats.tables > simStats.peak) simStats.peak = simStats.tables;
+
+    return f;
+}
+
+
+
+EXTERNC
+Frame_t PmmAllocateZeroed(PmmTag_t tag)
+{
+    return PmmAllocate(tag);
+}
+
+
+
+EXTERNC
+void PmmFree(Frame_t f)
+{
+    SimTable(f);
+
+    simDesc[f].owner = PMM_TAG_NONE;
+    simFree[simFreeCount ++] = f;
+    simStats.tables --;
+}
+
+
+
+/********************************************************************************************************************
+*   The simulated TLB: a single CPU, so a flush is only counted
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+void TlbFlush(TlbBatch_t *b)
+{
+    if (b->count == 0 && !b->full) return;
+
+    simStats.flushes ++;
+    if (b->full) simStats.fullFlushes ++;
+
+    b->count = 0;
+    b->full = false;
+}
+
+
+
+EXTERNC
+void TlbFlushLocal(TlbBatch_t *b)
+{
+    TlbFlush(b);
+}
+
+
+
+/********************************************************************************************************************
+*   Debug output and panics go to the terminal
+*///-----------------------------------------------------------------------------------------------------------------
+EXTERNC
+int DbgPrintf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int rv = vprintf(fmt, args);
+    va_end(args);
+
+    return rv;
+}
+
+
+
+EXTERNC
+void KernelPanic(const char *msg)
+{
+    fprintf(stderr, "PANIC: %s\n", msg);
+    abort();
+}
+
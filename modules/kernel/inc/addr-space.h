@@ -0,0 +1,172 @@
+/****************************************************************************************************************//**
+*   @file               addr-space.h
+*   @brief              Address spaces, tagged with Process Context Identifiers where the CPU supports them
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   Each CPU hands out its own PCIDs, in order, to the address spaces it runs.  A PCID handed out in the current
+*   generation is only ever used by one address space, so switching back to an address space with a PCID from the
+*   current generation keeps its TLB entries.  When a CPU runs out of PCIDs it starts a new generation: it flushes
+*   its whole TLB and every address space gets a fresh PCID the next time it runs there.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __ADDR_SPACE_H__
+#define __ADDR_SPACE_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                AS_CPU_WORDS
+*   @brief              The number of 64-bit words in the mask of CPUs which may hold an address space's translations
+*///-----------------------------------------------------------------------------------------------------------------
+#define AS_CPU_WORDS        ((MAX_CPU + 63) / 64)
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            AddrSpace_t
+*   @brief              Formalization of the \ref AddrSpace_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             AddrSpace_t
+*   @brief              An address space: a top-level paging table and the PCID it last had on each CPU
+*
+*   Each tag holds the generation in the upper bits and the PCID in the lower 12 bits; 0 means no PCID.  A CPU is
+*   in `cpuMask` from the time it switches to the address space until it no longer holds any of its translations:
+*   until its PCID is dropped or, without PCIDs, until it switches away.  Shootdowns for the user half go only to
+*   the CPUs in the mask.
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct AddrSpace_t {
+    Frame_t pml4;                               //!< The frame holding the top-level paging table
+    uint64_t tag[MAX_CPU];                      //!< The generation and PCID last assigned on each CPU
+    volatile uint64_t cpuMask[AS_CPU_WORDS];    //!< The CPUs which may hold translations for the address space
+} AddrSpace_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                kernelSpace
+*   @brief              The address space the kernel boots in, which has no user mappings
+*///-----------------------------------------------------------------------------------------------------------------
+extern AddrSpace_t kernelSpace;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool AddrSpaceOnCpu(AddrSpace_t *s, int cpu)
+*   @brief              May a CPU hold translations for an address space?
+*
+*   The caller must order its paging table changes before this check with a full fence.
+*
+*   @param              s                   The address space
+*   @param              cpu                 The CPU number
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+bool AddrSpaceOnCpu(AddrSpace_t *s, int cpu) {
+    return (__atomic_load_n(&s->cpuMask[cpu / 64], __ATOMIC_RELAXED) & ((uint64_t)1 << (cpu % 64))) != 0;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AddrSpaceInit(void)
+*   @brief              Prepare the kernel half of the address space to be shared by all address spaces
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void AddrSpaceInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AddrSpaceCpuOnline(void)
+*   @brief              Enable PCIDs on this CPU and record that it is running \ref kernelSpace
+*
+*   Called on each CPU once its `gs` segment is set up.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceCpuOnline(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool AddrSpaceCreate(AddrSpace_t *s)
+*   @brief              Create a new address space which shares the kernel half with all the others
+*
+*   @param              s                   The address space to initialize
+*
+*   @returns            Whether the address space could be created
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool AddrSpaceCreate(AddrSpace_t *s);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AddrSpaceDestroy(AddrSpace_t *s)
+*   @brief              Release the top-level paging table of an address space
+*
+*   The user half must already be unmapped and the address space must not be running on any CPU.
+*
+*   @param              s                   The address space
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceDestroy(AddrSpace_t *s);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AddrSpaceSwitch(AddrSpace_t *s)
+*   @brief              Switch this CPU to another address space, keeping its TLB entries when possible
+*
+*   @param              s                   The address space to run
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceSwitch(AddrSpace_t *s);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 AddrSpace_t *AddrSpaceCurrent(void)
+*   @brief              Get the address space this CPU is running
+*
+*   @returns            The address space this CPU is running; `nullptr` before the CPU is online
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+AddrSpace_t *AddrSpaceCurrent(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AddrSpaceDropLocal(AddrSpace_t *s)
+*   @brief              Forget the PCID this CPU holds for an address space it is not running
+*
+*   Used when translations for the address space change while they may still be cached under its PCID; the next
+*   switch to the address space gets a new PCID with an empty TLB.  The CPU leaves the address space's mask, so
+*   later shootdowns for its user half pass this CPU by.  Interrupts must be disabled.
+*
+*   @param              s                   The address space
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceDropLocal(AddrSpace_t *s);
+
+
+
+#endif
@@ -43,6 +43,39 @@ enum {
 
 
 
+/****************************************************************************************************************//**
+*   @def                FRAME_MAG_SIZE
+*   @brief              The number of frames a per-CPU frame magazine can hold
+*///-----------------------------------------------------------------------------------------------------------------
+#define FRAME_MAG_SIZE      64
+
+
+
+/****************************************************************************************************************//**
+*   @def                FRAME_MAG_BATCH
+*   @brief              The number of frames moved between a magazine and the PMM at one time
+*///-----------------------------------------------------------------------------------------------------------------
+#define FRAME_MAG_BATCH     (FRAME_MAG_SIZE / 2)
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            FrameMag_t
+*   @brief              Formalization of the \ref FrameMag_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             FrameMag_t
+*   @brief              A per-CPU cache of free frames which sits in front of the PMM
+*
+*   The magazine is only touched by its owning CPU with interrupts disabled, so it needs no lock.
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct FrameMag_t {
+    int count;                                  //!< The number of frames in the magazine
+    Frame_t frames[FRAME_MAG_SIZE];             //!< The free frames; a stack
+} FrameMag_t;
+
+
+
 /****************************************************************************************************************//**
 *   @typedef            Cpu_t
 *   @brief              Formalization of the \ref Cpu_t structure into a defined type
@@ -56,31 +89,54 @@ typedef struct Cpu_t {
     struct Cpu_t *cpu;                          //!< Self-pointer
     int cpuNumber;                              //!< The CPU Number
     bool isBP;                                  //!< Is this the boot processor?
-    volatile bool fenced;                       //!< Has this CPU been fenced and held?
     volatile int status;                        //!< The current CPU Status
     volatile int prevStatus;                    //!< The previous status when status is CPU_EXCEPTION or CPU_SERVICE
+    volatile int fenced;                        //!< Nonzero while this CPU is held; no interrupt stub writes it
     ArchCpu_t arch;                             //!< Architecture-specific data elements
+    FrameMag_t frameMag;                        //!< The cache of free frames for this CPU
+    int node;                                   //!< The NUMA node to which this CPU belongs
+    int nextColor;                              //!< The page color for this CPU's next colored frame allocation
 } Cpu_t;
 
 static_assert(__builtin_offsetof(Cpu_t, status) == 24,
         "The offset of the Cpu_t::status member is not aligned with .s code");
 static_assert(__builtin_offsetof(Cpu_t, prevStatus) == 28,
         "The offset of the Cpu_t::prevStatus member is not aligned with .s code");
+static_assert(__builtin_offsetof(Cpu_t, fenced) >= 32,
+        "The interrupt stubs write Cpu_t::status and Cpu_t::prevStatus (bytes 24-31); Cpu_t::fenced must not overlap");
+static_assert(sizeof(Cpu_t) <= PAGE_SIZE, "Each AP's per-CPU block is allocated in a single frame");
+
+
+
+/****************************************************************************************************************//**
+*   @var                cpuLocal
+*   @brief              The \ref Cpu_t at the start of every CPU's per-CPU block, where `gs` points
+*
+*   This is a per-CPU variable: its address is an offset, so only reach it through \ref PerCpuRead,
+*   \ref PerCpuWrite, \ref ThisCpu or \ref cpus.
+*///----------------------------------------------------------------------------------------------------------------
+extern PER_CPU_FIRST
+Cpu_t cpuLocal;
 
 
 
 /****************************************************************************************************************//**
 *   @var                cpus
 *   @brief              CPU abstraction structure for each CPU in this Arch
+*
+*   Each entry is the start of that CPU's per-CPU block, a copy of the `.percpu` section padded to whole cache
+*   lines.  The boot processor's block is reserved in `.bss` by the linker; each AP's is allocated on its own NUMA
+*   node by \ref ApStart.  The entries for CPUs which have not been allocated are `nullptr`.
 *///----------------------------------------------------------------------------------------------------------------
 extern KERNEL_BSS
-Cpu_t cpus[MAX_CPU];
+Cpu_t *cpus[MAX_CPU];
 
 
 
 /****************************************************************************************************************//**
 *   @var                cpuCount
-*   @brief              The number of CPUs discovered on this system
+*   @brief              The number of CPUs discovered on this system; CPUs are numbered from 0 (the BP) in the
+*                       order \ref CpuAdd finds them
 *///----------------------------------------------------------------------------------------------------------------
 extern KERNEL_BSS
 int cpuCount;
@@ -91,15 +147,72 @@ int cpuCount;
 *   @fn                 void BpCpuInit(void)
 *   @brief              Perform the CPU initialization
 *///----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void BpCpuInit(void);
 
 
+/****************************************************************************************************************//**
+*   @fn                 int CpuAdd(uint32_t apicId)
+*   @brief              Give the CPU with an APIC ID the next CPU number, unless it already has one
+*
+*   The BP is added first, by \ref LapicInit, so it is CPU 0.  The APs are added as the MADT lists them.
+*
+*   @param              apicId              The (x2)APIC ID
+*
+*   @returns            The CPU number; -1 if \ref MAX_CPU CPUs are already known
+*///----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+int CpuAdd(uint32_t apicId);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 int CpuFromApicId(uint32_t apicId)
+*   @brief              Find the CPU number for an APIC ID
+*
+*   @param              apicId              The (x2)APIC ID
+*
+*   @returns            The CPU number; -1 if the APIC ID is not known
+*///----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+int CpuFromApicId(uint32_t apicId);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint32_t CpuApicId(int cpu)
+*   @brief              Get the APIC ID of a CPU, for addressing IPIs
+*
+*   @param              cpu                 The CPU number
+*
+*   @returns            The (x2)APIC ID
+*///----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint32_t CpuApicId(int cpu);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void CpuSetNode(int cpu, int node)
+*   @brief              Record the NUMA node of a CPU, which may be an AP whose structure is not yet allocated
+*
+*   @param              cpu                 The CPU number
+*   @param              node                The NUMA node
+*///----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void CpuSetNode(int cpu, int node);
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 void ApStart(void)
 *   @brief              Start any AP CPUs
+*
+*   The per-CPU blocks for the `cpuCount` CPUs found by \ref PlatformDiscovery are copied from the `.percpu`
+*   template first, each on its CPU's NUMA node, so this must run after the PMM zones are set up.  The template is
+*   in `.kinit`.
 *///----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void ApStart(void);
 
 
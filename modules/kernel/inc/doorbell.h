@@ -0,0 +1,83 @@
+/****************************************************************************************************************//**
+*   @file               doorbell.h
+*   @brief              Waiting for another CPU to change a flag, without spinning on it
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   A doorbell is any `int` which one CPU waits on until another CPU changes it.  Where the CPU supports
+*   MONITOR/MWAIT, the waiter sleeps on the flag's cache line and the write which rings the bell wakes it; otherwise
+*   the waiter polls with PAUSE, backing off so it leaves the memory bus (and its sibling hyperthread) alone.
+*
+*   A waiter also wakes for interrupts, which are handled before it goes back to sleep.  Since any write to the
+*   line wakes an MWAIT, the flag is best kept on a line which is not written for other reasons.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __DOORBELL_H__
+#define __DOORBELL_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void DoorbellInit(void)
+*   @brief              Determine whether waiters may use MONITOR/MWAIT; until then they poll
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void DoorbellInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void DoorbellWait(volatile int *bell, int value)
+*   @brief              Wait for as long as a flag holds a value
+*
+*   @param              bell                The flag
+*   @param              value               The value to wait out
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void DoorbellWait(volatile int *bell, int value);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void DoorbellWaitUntil(volatile int *bell, int value)
+*   @brief              Wait until a flag holds a value, such as a count of outstanding replies reaching 0
+*
+*   @param              bell                The flag
+*   @param              value               The value to wait for
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void DoorbellWaitUntil(volatile int *bell, int value);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void DoorbellRing(volatile int *bell, int value)
+*   @brief              Set a flag, releasing any CPU waiting on it; everything written before is visible to the waiter
+*
+*   @param              bell                The flag
+*   @param              value               The new value
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void DoorbellRing(volatile int *bell, int value);
+
+
+
+#endif
@@ -0,0 +1,183 @@
+/****************************************************************************************************************//**
+*   @file               frame.h
+*   @brief              Per-frame descriptors
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   Every frame of available memory has a small descriptor which holds its reference count, flags, owner and
+*   NUMA node, and the links for an LRU list.  The descriptors form a virtually linear array at
+*   `FRAME_DESC_ADDR` indexed by frame number; only the parts of the array which describe available memory are
+*   backed by frames, so holes in the memory map cost nothing.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+
+
+#include "arch.h"
+
+
+
+/********************************************************************************************************************
+*   The flags which may be set on a frame descriptor
+*///-----------------------------------------------------------------------------------------------------------------
+enum {
+    FRAME_PRESENT = 0x0001,             //!< The frame is available memory and is managed by the PMM
+    FRAME_KERNEL = 0x0002,              //!< The frame holds kernel data which cannot be reclaimed
+    FRAME_PGTABLE = 0x0004,             //!< The frame holds a paging table
+    FRAME_COW = 0x0008,                 //!< The frame is shared copy-on-write; copy it before writing
+    FRAME_ON_LRU = 0x0010,              //!< The frame is linked on an LRU list
+    FRAME_DIRTY = 0x0020,               //!< The frame has been modified since it was last written back
+};
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            FrameDesc_t
+*   @brief              Formalization of the \ref FrameDesc_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             FrameDesc_t
+*   @brief              The metadata kept for a single frame
+*
+*   The structure is 16 bytes so that 4 descriptors share a cache line and a page holds 256 of them.  The LRU links
+*   are frame numbers rather than pointers to keep the structure small; frame 0 is never managed, so it terminates
+*   the list.
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct FrameDesc_t {
+    volatile uint32_t refCount;                 //!< The number of references to this frame; 0 when free
+    uint16_t flags;                             //!< The FRAME_* flags
+    uint8_t node;                               //!< The NUMA node holding this frame
+    uint8_t owner;                              //!< A tag for the subsystem which allocated the frame
+    uint32_t lruNext;                           //!< The next frame on the LRU list
+    uint32_t lruPrev;                           //!< The previous frame on the LRU list
+} FrameDesc_t;
+
+static_assert(sizeof(FrameDesc_t) == 16, "FrameDesc_t must stay 16 bytes");
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 FrameDesc_t *FrameGetDesc(Frame_t f)
+*   @brief              Get the descriptor for a frame
+*
+*   @param              f                   The frame; it must be available memory
+*
+*   @returns            The descriptor for frame `f`
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+FrameDesc_t *FrameGetDesc(Frame_t f) {
+    return &((FrameDesc_t *)FRAME_DESC_ADDR)[f];
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FrameDescInit(void)
+*   @brief              Build the frame descriptor array for all available memory
+*
+*   Frames already in use when this runs are left with a reference count of 0 and are never released through
+*   \ref FrameRelease.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FrameDescInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FrameSetNode(Frame_t start, Frame_t end, int node)
+*   @brief              Record the NUMA node for the available frames in a range
+*
+*   @param              start               The first frame in the range
+*   @param              end                 The frame after the last frame in the range
+*   @param              node                The NUMA node
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FrameSetNode(Frame_t start, Frame_t end, int node);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FrameOnAlloc(Frame_t f, int order, int owner)
+*   @brief              Initialize the descriptors of a newly allocated block of frames
+*
+*   Called by the PMM.  Each frame starts with a reference count of 1 and no flags other than `FRAME_PRESENT`.
+*
+*   @param              f                   The first frame of the block
+*   @param              order               The order of the block
+*   @param              owner               The allocation-site tag (\ref PmmTag_t) to record
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void FrameOnAlloc(Frame_t f, int order, int owner);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 int FrameOnFree(Frame_t f, int order)
+*   @brief              Clear the descriptors of a block of frames being returned to the PMM
+*
+*   Freeing a frame gives up the caller's reference, so it is fatal for any frame in the block to have more than
+*   one reference left.
+*   @param              f                   The first frame of the block
+*   @param              order               The order of the block
+*
+*   @returns            The allocation-site tag the block was allocated with; 0 if it is not known
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+int FrameOnFree(Frame_t f, int order);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FrameAddRef(Frame_t f)
+*   @brief              Add a reference to a frame which is being shared
+*
+*   @param              f                   The frame
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void FrameAddRef(Frame_t f);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool FrameRelease(Frame_t f)
+*   @brief              Drop a reference to a frame; the frame is returned to the PMM with the last reference
+*
+*   @param              f                   The frame
+*
+*   @returns            Whether the frame was freed
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool FrameRelease(Frame_t f);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool FrameIsAvailable(Frame_t f)
+*   @brief              Determine if a frame is available memory, without consulting the Multiboot memory map
+*
+*   @param              f                   The frame
+*
+*   @returns            Whether frame `f` has a descriptor marked `FRAME_PRESENT`
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool FrameIsAvailable(Frame_t f);
+
+
+
+#endif
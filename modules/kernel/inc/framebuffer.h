@@ -0,0 +1,84 @@
+/****************************************************************************************************************//**
+*   @file               framebuffer.h
+*   @brief              The linear frame buffer set up by the boot loader
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   The frame buffer is mapped write-combining: writes are gathered into whole lines before they go out on the
+*   bus, rather than one bus transaction for each store as with uncached memory.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __FRAMEBUFFER_H__
+#define __FRAMEBUFFER_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            Framebuffer_t
+*   @brief              Formalization of the \ref Framebuffer_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             Framebuffer_t
+*   @brief              The frame buffer and where it is mapped
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct Framebuffer_t {
+    Addr_t base;                                //!< The virtual address of the first pixel; 0 if there is none
+    Addr_t phys;                                //!< The physical address of the first pixel
+    size_t pages;                               //!< The number of pages mapped
+    uint32_t pitch;                             //!< The number of bytes in each line
+    uint32_t width;                             //!< The width in pixels
+    uint32_t height;                            //!< The height in pixels
+    uint8_t bpp;                                //!< The number of bits in each pixel
+} Framebuffer_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                framebuffer
+*   @brief              The frame buffer provided by the boot loader
+*///-----------------------------------------------------------------------------------------------------------------
+extern Framebuffer_t framebuffer;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FbInit(void)
+*   @brief              Find the graphics frame buffer in the Multiboot Information and map it write-combining
+*
+*   Must be called before \ref MbootRelease.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FbInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FbBenchmark(void)
+*   @brief              Compare filling and blitting the frame buffer when it is mapped uncached and write-combining
+*
+*   The frame buffer is left mapped write-combining and cleared.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FbBenchmark(void);
+
+
+
+#endif
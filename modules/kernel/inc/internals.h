@@ -336,7 +336,7 @@ void kMemMove(void *tgt, void *src, size_t cnt);
 *   @fn                 void EarlyInit(void)
 *   @brief              Complete the early initialization tasks
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void EarlyInit(void);
 
 
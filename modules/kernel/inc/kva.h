@@ -0,0 +1,91 @@
+/****************************************************************************************************************//**
+*   @file               kva.h
+*   @brief              The kernel virtual address space allocator
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   Hands out page-aligned ranges of kernel virtual address space from `KVA_ADDR`, for mappings whose address does
+*   not matter: stacks, device registers, temporary windows.  Free ranges are kept on per-size lists (one list per
+*   power of 2) so a first-fit search only looks at ranges which are large enough.
+*
+*   Freed ranges are unmapped at once, but the TLB is not flushed and the range is not reused until a purge: the
+*   purge flushes the TLB once on every CPU for all the ranges freed since the last one.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __KVA_H__
+#define __KVA_H__
+
+
+
+#include "arch.h"
+
+
+
+/********************************************************************************************************************
+*   The flags for \ref KvaAlloc
+*///-----------------------------------------------------------------------------------------------------------------
+enum {
+    KVA_GUARD = 0x0001,                 //!< Leave an unmapped page below the range to catch a stack overflow
+};
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaInit(void)
+*   @brief              Make the whole KVA region available
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void KvaInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t KvaAlloc(size_t pages, int flags)
+*   @brief              Allocate a range of kernel virtual address space; nothing is mapped
+*
+*   @param              pages               The number of usable pages
+*   @param              flags               The KVA_* flags
+*
+*   @returns            The address of the first usable page; 0 if the space is exhausted
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Addr_t KvaAlloc(size_t pages, int flags);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaFree(Addr_t a)
+*   @brief              Unmap and release a range allocated by \ref KvaAlloc
+*
+*   The frames which were mapped are not freed.  Other CPUs may hold stale translations for the range until the
+*   next \ref KvaPurge; the range is not handed out again before then.
+*
+*   @param              a                   The address returned by \ref KvaAlloc
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaFree(Addr_t a);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaPurge(void)
+*   @brief              Flush the TLB for every range freed since the last purge and make the ranges available
+*
+*   Runs on its own once enough pages are waiting, or when an allocation cannot otherwise be satisfied.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaPurge(void);
+
+
+
+#endif
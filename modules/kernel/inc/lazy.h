@@ -0,0 +1,93 @@
+/****************************************************************************************************************//**
+*   @file               lazy.h
+*   @brief              Regions of virtual memory which are backed by frames only when they are first touched
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   A lazy region is reserved address space with nothing mapped.  The first touch of each page raises a page fault
+*   and the handler maps a zero-filled frame there, so a large region costs nothing until it is used.
+*
+*   A read from user mode maps the shared zero frame read-only; the first write then replaces it with a private
+*   frame.  The kernel runs with `CR0.WP` clear, so it could write through a read-only mapping of the zero frame;
+*   the kernel therefore gets a private frame on the first touch, read or write.
+*
+*   The fault handler allocates frames and maps them under the MMU's lock, so code holding a PMM lock or the MMU
+*   lock must not touch a lazy page for the first time.  Kernel stacks are run on with those locks held, so they
+*   are never lazy.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __LAZY_H__
+#define __LAZY_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void LazyInit(void)
+*   @brief              Allocate the shared zero frame; the PMM and the direct map must be ready
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void LazyInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool LazyRegister(Addr_t a, size_t pages, int flags)
+*   @brief              Register a range of unmapped pages to be backed on first touch
+*
+*   A range below `USER_SPACE_END` belongs to the address space this CPU is running.
+*
+*   @param              a                   The page-aligned start of the range
+*   @param              pages               The number of pages
+*   @param              flags               The PG_* flags for the pages once they are mapped
+*
+*   @returns            Whether the range could be registered
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool LazyRegister(Addr_t a, size_t pages, int flags);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void LazyRelease(Addr_t a)
+*   @brief              Forget a lazy region, unmapping it and freeing the frames which were touched
+*
+*   @param              a                   The start of the range, as passed to \ref LazyRegister
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void LazyRelease(Addr_t a);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void LazyPageFault(Addr_t a, uint64_t err)
+*   @brief              Resolve a page fault; called from the #PF handler
+*
+*   Returns once the faulting page is mapped so the access can be retried.  A fault outside a lazy region is fatal.
+*
+*   @param              a                   The faulting address, from `cr2`
+*   @param              err                 The PF_* bits of the error code
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void LazyPageFault(Addr_t a, uint64_t err);
+
+
+
+#endif
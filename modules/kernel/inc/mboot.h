@@ -0,0 +1,201 @@
+/****************************************************************************************************************//**
+*   @file               mboot.h
+*   @brief              Access to the Multiboot 2 Information provided by the boot loader
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   `entry.s` saves the location of the Multiboot Information structure in `mbData`.  These functions map that
+*   structure and provide access to the tags in it.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __MBOOT_H__
+#define __MBOOT_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                MBOOT_SIG
+*   @brief              The signature the Multiboot 2 loader leaves in `eax`
+*///-----------------------------------------------------------------------------------------------------------------
+#define MBOOT_SIG       0x36d76289
+
+
+
+/********************************************************************************************************************
+*   The Multiboot Information tag types we are interested in
+*///-----------------------------------------------------------------------------------------------------------------
+enum {
+    MBOOT_TAG_END = 0,                  //!< The terminating tag
+    MBOOT_TAG_MODULE = 3,               //!< A loaded module
+    MBOOT_TAG_MMAP = 6,                 //!< The memory map
+    MBOOT_TAG_FRAMEBUFFER = 8,          //!< The frame buffer information
+};
+
+
+
+/********************************************************************************************************************
+*   The memory map entry types
+*///-----------------------------------------------------------------------------------------------------------------
+enum {
+    MBOOT_MEM_AVAILABLE = 1,            //!< The memory is available for use
+    MBOOT_MEM_RESERVED = 2,             //!< The memory is reserved
+    MBOOT_MEM_ACPI = 3,                 //!< The memory holds ACPI information and is reclaimable
+    MBOOT_MEM_NVS = 4,                  //!< The memory must be preserved across hibernation
+    MBOOT_MEM_BAD = 5,                  //!< The memory is defective
+};
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            MbootTag_t
+*   @brief              Formalization of the \ref MbootTag_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MbootTag_t
+*   @brief              The header common to all Multiboot Information tags
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct MbootTag_t {
+    uint32_t type;                  //!< The tag type
+    uint32_t size;                  //!< The size of the tag, not including padding to the 8-byte boundary
+} PACKED MbootTag_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            MbootModule_t
+*   @brief              Formalization of the \ref MbootModule_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MbootModule_t
+*   @brief              A module loaded by the boot loader (tag type 3)
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct MbootModule_t {
+    MbootTag_t tag;                 //!< The common tag header
+    uint32_t modStart;              //!< The physical starting address of the module
+    uint32_t modEnd;                //!< The physical ending address of the module
+    char name[0];                   //!< The NULL-terminated module command line
+} PACKED MbootModule_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            MbootMmapEntry_t
+*   @brief              Formalization of the \ref MbootMmapEntry_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MbootMmapEntry_t
+*   @brief              A single entry in the memory map
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct MbootMmapEntry_t {
+    uint64_t addr;                  //!< The starting physical address of the block
+    uint64_t len;                   //!< The length of the block in bytes
+    uint32_t type;                  //!< The type of memory
+    uint32_t reserved;              //!< Reserved; set to 0
+} PACKED MbootMmapEntry_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            MbootMmap_t
+*   @brief              Formalization of the \ref MbootMmap_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MbootMmap_t
+*   @brief              The memory map tag (tag type 6)
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct MbootMmap_t {
+    MbootTag_t tag;                 //!< The common tag header
+    uint32_t entrySize;             //!< The size of each entry; may be larger than \ref MbootMmapEntry_t
+    uint32_t entryVersion;          //!< The version of the entries
+    MbootMmapEntry_t entries[0];    //!< The memory map entries; use `entrySize` to walk the list
+} PACKED MbootMmap_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            MbootFramebuffer_t
+*   @brief              Formalization of the \ref MbootFramebuffer_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MbootFramebuffer_t
+*   @brief              The frame buffer information tag (tag type 8); the color information which follows is omitted
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct MbootFramebuffer_t {
+    MbootTag_t tag;                 //!< The common tag header
+    uint64_t addr;                  //!< The physical address of the frame buffer
+    uint32_t pitch;                 //!< The number of bytes in each line
+    uint32_t width;                 //!< The width in pixels (or characters for EGA text)
+    uint32_t height;                //!< The height in pixels (or characters for EGA text)
+    uint8_t bpp;                    //!< The number of bits in each pixel
+    uint8_t type;                   //!< 0 = indexed color; 1 = direct RGB color; 2 = EGA text
+    uint8_t reserved;               //!< Reserved; set to 0
+} PACKED MbootFramebuffer_t;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void MbootInit(void)
+*   @brief              Validate and map the Multiboot Information structure so that it can be read
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void MbootInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 MbootTag_t *MbootFindTag(uint32_t type, MbootTag_t *prev)
+*   @brief              Find a tag in the Multiboot Information structure
+*
+*   @param              type                The type of tag to find
+*   @param              prev                The previous tag found, or `nullptr` to start at the beginning
+*
+*   @returns            The next tag of the requested type; `nullptr` when there are no more
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+MbootTag_t *MbootFindTag(uint32_t type, MbootTag_t *prev);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void MbootGetRange(Addr_t *start, Addr_t *end)
+*   @brief              Report the physical memory occupied by the Multiboot Information structure
+*
+*   @param              start               Receives the starting physical address
+*   @param              end                 Receives the ending physical address (exclusive)
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void MbootGetRange(Addr_t *start, Addr_t *end);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void MbootRelease(void)
+*   @brief              Unmap the Multiboot Information structure and return its frames to the PMM
+*
+*   Frames shared with the kernel image or a module are kept.  The MBI is reached through the identity map, so this
+*   must run before \ref ArchReleaseBootMemory.  Once this is called, \ref MbootFindTag will not find any more tags.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void MbootRelease(void);
+
+
+
+#endif
@@ -27,6 +27,54 @@
 
 
 #include "arch.h"
+#include "tlb.h"
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t PhysToVirt(Addr_t p)
+*   @brief              Get the address of physical memory in the direct map
+*
+*   The direct map covers all the memory in the boot loader's memory map, so no mapping is needed to reach it.
+*
+*   @param              p                   The physical address
+*
+*   @returns            The virtual address at which `p` can be reached
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Addr_t PhysToVirt(Addr_t p) {
+    return DIRECT_MAP_ADDR + p;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t VirtToPhys(Addr_t a)
+*   @brief              Get the physical address behind a virtual address
+*
+*   Addresses in the direct map are translated directly; any other address is looked up in the paging tables.
+*
+*   @param              a                   The virtual address
+*
+*   @returns            The physical address mapped at `a`; 0 if `a` is not mapped
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Addr_t VirtToPhys(Addr_t a) {
+    if (a >= DIRECT_MAP_ADDR && a - DIRECT_MAP_ADDR < DIRECT_MAP_SIZE) return a - DIRECT_MAP_ADDR;
+    return ArchMmuVirtToPhys(a);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void MmuDirectMapInit(void)
+*   @brief              Build the direct map of physical memory from the boot loader's memory map
+*
+*   RAM, including the ACPI regions, is mapped write-back; reserved regions are mapped uncached, since they may
+*   hold device registers.  Large pages are used wherever the memory map allows.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void MmuDirectMapInit(void);
 
 
 
@@ -43,4 +91,80 @@ void MapPage(Addr_t a, Frame_t f, int flags);
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 bool IsMapped(Addr_t a)
+*   @brief              Determine if an address is mapped to a frame
+*
+*   @param              a                   The address to check
+*
+*   @returns            Whether the page containing `a` is mapped
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool IsMapped(Addr_t a);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void UnmapPage(Addr_t a)
+*   @brief              Remove the mapping for a page in Virtual Memory Space
+*
+*   The frame which was mapped is not freed; that is up to the caller.  A paging table left empty is freed.
+*
+*   @param              a                   The address to unmap
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void UnmapPage(Addr_t a);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void MapRange(Addr_t a, Frame_t f, size_t count, int flags)
+*   @brief              Map a run of pages in Virtual Memory Space to a run of contiguous Physical Frames
+*
+*   Much cheaper than calling \ref MapPage for each page: each table is walked once per 512 pages and the TLB is
+*   invalidated once for the whole run.
+*
+*   @param              a                   The address of the first page
+*   @param              f                   The first frame
+*   @param              count               The number of pages to map
+*   @param              flags               Flags which will help control the mapping security
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void MapRange(Addr_t a, Frame_t f, size_t count, int flags);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void UnmapRange(Addr_t a, size_t count)
+*   @brief              Remove the mappings for a run of pages in Virtual Memory Space
+*
+*   The frames which were mapped are not freed; that is up to the caller.  Paging tables left empty are freed, and
+*   the TLB is invalidated once for the whole run.
+*
+*   @param              a                   The address of the first page
+*   @param              count               The number of pages to unmap
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void UnmapRange(Addr_t a, size_t count);
+
+
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void UnmapRangeDeferred(Addr_t a, size_t count, TlbBatch_t *batch)
+*   @brief              Remove the mappings for a run of pages without invalidating the TLB
+*
+*   The invalidations are queued in `batch`, so many unmaps can share one shootdown.  Until the batch is flushed,
+*   other CPUs may still reach the old frames through the old addresses, so neither may be reused before then.
+*
+*   @param              a                   The address of the first page
+*   @param              count               The number of pages to unmap
+*   @param              batch               The batch which will invalidate the old translations
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void UnmapRangeDeferred(Addr_t a, size_t count, TlbBatch_t *batch);
+
+
+
 #endif
@@ -31,13 +31,377 @@
 
 
 /****************************************************************************************************************//**
-*   @fn                 Frame_t PmmAllocate(void)
+*   @def                EARLY_FRAME_START
+*   @brief              The first frame handed out by the early frame allocator in `entry.s` (16M)
+*///-----------------------------------------------------------------------------------------------------------------
+#define EARLY_FRAME_START       (4 * 1024)
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_MAX_ORDER
+*   @brief              The number of block orders managed by the buddy allocator
+*
+*   Order 0 is a single 4K frame; order 9 is a 2M block; the largest order (18) is a 1G block.
+*///-----------------------------------------------------------------------------------------------------------------
+#define PMM_MAX_ORDER           19
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_MAX_NODES
+*   @brief              The number of NUMA nodes supported by the PMM
+*///-----------------------------------------------------------------------------------------------------------------
+#define PMM_MAX_NODES           8
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_MAX_ZONES
+*   @brief              The number of memory zones (ranges of frames on a single NUMA node) supported by the PMM
+*///-----------------------------------------------------------------------------------------------------------------
+#define PMM_MAX_ZONES           16
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_ZERO_POOL_SIZE
+*   @brief              The number of pre-zeroed frames idle CPUs keep ready
+*///-----------------------------------------------------------------------------------------------------------------
+#define PMM_ZERO_POOL_SIZE      256
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_MAX_COLORS
+*   @brief              The largest number of page colors the PMM will track
+*
+*   Caches with more colors than this are treated as having this many, which still spreads frames across
+*   `PMM_MAX_COLORS` groups of sets.
+*///-----------------------------------------------------------------------------------------------------------------
+#define PMM_MAX_COLORS          64
+
+
+
+/****************************************************************************************************************//**
+*   @enum               PmmTag_t
+*   @brief              The allocation-site tags; each PMM allocation names the subsystem it is for
+*
+*   The tag is kept in the frame descriptor's `owner` field so that the frame is credited back to the same tag
+*   when it is freed.
+*///-----------------------------------------------------------------------------------------------------------------
+enum PmmTag_t {
+    PMM_TAG_NONE = 0,                   //!< Untagged
+    PMM_TAG_PMM = 1,                    //!< The PMM bitmaps
+    PMM_TAG_FRAME_DESC = 2,             //!< The frame descriptor array
+    PMM_TAG_PGTABLE = 3,                //!< Paging tables
+    PMM_TAG_STACK = 4,                  //!< Kernel stacks
+    PMM_TAG_ZERO_POOL = 5,              //!< Frames waiting in the pre-zeroed pool
+    PMM_TAG_TEST = 6,                   //!< Boot-time tests and benchmarks
+    PMM_TAG_DEMAND = 7,                 //!< Frames mapped on first touch of a lazy region
+    PMM_TAG_CPU = 8,                    //!< The per-CPU structures of the APs
+    PMM_TAG_COUNT = 9,                  //!< The number of tags; not a tag
+};
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmInit(void)
+*   @brief              Initialize the Physical Memory Manager from the Multiboot memory map
+*
+*   Until this function completes, frames are handed out by the early frame allocator (`earlyFrame` from
+*   `entry.s`).  Once complete, all frames consumed so far have been marked as used and the bitmap is
+*   authoritative.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmInit(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmAllocate(PmmTag_t tag)
 *   @brief              Allocate a frame
 *
+*   The frame comes from this CPU's frame magazine, which is refilled in a batch from the buddy allocator when
+*   it is empty.
+*
+*   @param              tag                 The allocation-site tag
+*
 *   @returns            A frame number which has now been allocated to the requestor.
+*
+*   @retval             0                   There are no more frames available
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocate(PmmTag_t tag);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmAllocateZeroed(PmmTag_t tag)
+*   @brief              Allocate a frame which is already filled with zeros
+*
+*   The frame comes from the pool of frames zeroed in the background by idle CPUs (see \ref PmmZeroIdle).  When
+*   the pool is empty the caller should fall back to \ref PmmAllocate and clear the frame itself.
+*
+*   @param              tag                 The allocation-site tag
+*
+*   @returns            A zeroed frame which has now been allocated to the requestor.
+*
+*   @retval             0                   The pool of zeroed frames is empty
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateZeroed(PmmTag_t tag);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool PmmZeroIdle(void)
+*   @brief              Zero one frame into the pre-zeroed pool; called from a CPU's idle loop
+*
+*   The frame is cleared through the direct map with non-temporal stores so that the work does not evict anything
+*   useful from the cache.  No paging tables are touched, so any number of CPUs may do this at once.
+*
+*   @returns            Whether a frame was added to the pool
+*
+*   @retval             false               The pool is full (or there is no memory); the CPU may rest
+*   @retval             true                A frame was zeroed; call again
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool PmmZeroIdle(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmAllocateOrder(int order, PmmTag_t tag)
+*   @brief              Allocate a block of physically contiguous frames
+*
+*   The block is `1 << order` frames long and is naturally aligned to its size.  A larger block is split when no
+*   block of the requested order is free.  Memory local to this CPU's NUMA node is preferred.
+*
+*   @param              order               The order of the block to allocate
+*   @param              tag                 The allocation-site tag
+*
+*   @returns            The first frame of the allocated block.
+*
+*   @retval             0                   There is no block of that size available
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateOrder(int order, PmmTag_t tag);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmAllocateNode(int node, PmmTag_t tag)
+*   @brief              Allocate a frame on a given NUMA node, for data which belongs to a CPU other than this one
+*
+*   The frame comes from the buddy allocator rather than this CPU's magazine.  When the node has no free memory,
+*   the nearest node with memory is used.
+*
+*   @param              node                The NUMA node
+*   @param              tag                 The allocation-site tag
+*
+*   @returns            A frame number which has now been allocated to the requestor.
+*
+*   @retval             0                   There are no more frames available
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateNode(int node, PmmTag_t tag);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmFree(Frame_t f)
+*   @brief              Return a frame to the PMM
+*
+*   The frame is returned to this CPU's frame magazine; when the magazine is full, half of it is drained back to
+*   the buddy allocator.
+*
+*   @param              f                   The frame to release
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmFree(Frame_t f);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmFreeOrder(Frame_t f, int order)
+*   @brief              Return a block of frames allocated with \ref PmmAllocateOrder to the PMM
+*
+*   The block is coalesced with its buddy for as long as the buddy is also free.
+*
+*   @param              f                   The first frame of the block
+*   @param              order               The order the block was allocated with
 *///-----------------------------------------------------------------------------------------------------------------
 KRN_FUNC
-Frame_t PmmAllocate(void);
+void PmmFreeOrder(Frame_t f, int order);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmReleaseRange(Frame_t start, Frame_t end)
+*   @brief              Return a range of frames which were reserved at boot to the PMM
+*
+*   Frames which are not available memory (according to the frame descriptors) are skipped, so this is safe to
+*   call on ranges which may include firmware memory.
+*
+*   @param              start               The first frame in the range
+*   @param              end                 The frame after the last frame in the range
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmReleaseRange(Frame_t start, Frame_t end);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t PmmFreeCount(void)
+*   @brief              Report the number of frames currently free
+*
+*   @returns            The number of free frames
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmFreeCount(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t PmmFreeCountOrder(int order)
+*   @brief              Report the number of free blocks of a given order
+*
+*   @param              order               The order to query
+*
+*   @returns            The number of free blocks of `order`; 0 when the order is out of range
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmFreeCountOrder(int order);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t PmmNodeFreeCount(int node)
+*   @brief              Report the number of frames free in the buddy allocator on a NUMA node
+*
+*   @param              node                The NUMA node to query
+*
+*   @returns            The number of free frames on `node`, not counting frames held in per-CPU magazines
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmNodeFreeCount(int node);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t PmmNodeUsedCount(int node)
+*   @brief              Report the number of available frames on a NUMA node which are not free
+*
+*   @param              node                The NUMA node to query
+*
+*   @returns            The number of used frames on `node`, including frames held in per-CPU magazines
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmNodeUsedCount(int node);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmAddMemoryAffinity(Frame_t start, Frame_t end, int node)
+*   @brief              Record that a range of frames belongs to a NUMA node
+*
+*   Called by platform discovery for each memory range it finds; the ranges take effect in \ref PmmInitZones.
+*
+*   @param              start               The first frame in the range
+*   @param              end                 The frame after the last frame in the range
+*   @param              node                The NUMA node
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmAddMemoryAffinity(Frame_t start, Frame_t end, int node);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmSetNodeDistance(int from, int to, int distance)
+*   @brief              Record the relative distance from one NUMA node to another
+*
+*   @param              from                The node making the access
+*   @param              to                  The node being accessed
+*   @param              distance            The relative distance; 10 is local
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmSetNodeDistance(int from, int to, int distance);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmInitZones(void)
+*   @brief              Partition the frames into per-node zones from the reported memory affinity
+*
+*   Until this is called (or when no affinity is reported), all frames are in a single zone on node 0.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmInitZones(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmDumpStats(void)
+*   @brief              Report the PMM statistics over the debug serial port
+*
+*   The report covers the free blocks and the allocation counts for each zone and each order, a fragmentation
+*   figure for each zone, the magazine counters, and the frames currently held under each allocation-site tag.
+*   The counters are kept per CPU and summed here, so the report is approximate while other CPUs are allocating.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmDumpStats(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmInitColors(void)
+*   @brief              Determine the number of page colors from the cache geometry
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmInitColors(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmSetColoring(bool on)
+*   @brief              Turn page-colored allocation on or off
+*
+*   When on, each CPU's successive calls to \ref PmmAllocate walk through the page colors in turn, so that the
+*   frames a CPU allocates together spread across the cache sets instead of aliasing into the same ones.  A
+*   frame of the wanted color is looked for in the CPU's magazine first and then in the buddy allocator, where the
+*   smallest free block holding that color is split; if no free frame has the color any frame is returned.  Off by
+*   default: a colored allocation is slower than a plain one.
+*
+*   @param              on                  Whether page coloring should be used
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmSetColoring(bool on);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 int PmmColorCount(void)
+*   @brief              Report the number of page colors in use
+*
+*   @returns            The number of page colors; 1 when coloring is not possible
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+int PmmColorCount(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmColorBenchmark(void)
+*   @brief              Compare the cache conflict behavior of allocations with page coloring off and on
+*
+*   Memory is first fragmented by holding 3 of every 4 frames of a run, the way a long-lived user would.  Then a
+*   set of frames is allocated with coloring off and with it on; for each, the worst number of frames sharing a
+*   color and the cycles to read the same line of every frame repeatedly are reported.  Must be called on the BP
+*   before the APs are started.
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmColorBenchmark(void);
 
 
 #endif
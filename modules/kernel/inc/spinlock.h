@@ -0,0 +1,92 @@
+/****************************************************************************************************************//**
+*   @file               spinlock.h
+*   @brief              A simple spinlock used to protect shared kernel structures
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   A spinlock is the most primitive lock in the kernel.  It is intended to be held for very short periods of time
+*   when a structure is shared between CPUs.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __SPINLOCK_H__
+#define __SPINLOCK_H__
+
+
+
+#include "arch.h"
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            Spinlock_t
+*   @brief              Formalization of the \ref Spinlock_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             Spinlock_t
+*   @brief              A spinlock
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct Spinlock_t {
+    volatile int lock;                          //!< 0 when the lock is available; 1 when it is held
+} Spinlock_t;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SpinLock(Spinlock_t *l)
+*   @brief              Acquire a spinlock, waiting until it becomes available
+*
+*   @param              l                   The lock to acquire
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void SpinLock(Spinlock_t *l) {
+    while (__atomic_exchange_n(&l->lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        while (l->lock) PAUSE();
+    }
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool SpinTryLock(Spinlock_t *l)
+*   @brief              Attempt to acquire a spinlock without waiting
+*
+*   @param              l                   The lock to acquire
+*
+*   @returns            Whether the lock was acquired
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+bool SpinTryLock(Spinlock_t *l) {
+    if (l->lock) return false;
+    return __atomic_exchange_n(&l->lock, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void SpinUnlock(Spinlock_t *l)
+*   @brief              Release a spinlock
+*
+*   @param              l                   The lock to release
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void SpinUnlock(Spinlock_t *l) {
+    __atomic_store_n(&l->lock, 0, __ATOMIC_RELEASE);
+}
+
+
+
+#endif
@@ -0,0 +1,185 @@
+/****************************************************************************************************************//**
+*   @file               tlb.h
+*   @brief              TLB shootdown across CPUs
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   When a present mapping changes, every CPU which might hold the old translation must drop it.  Invalidations
+*   are queued in a \ref TlbBatch_t for a single address space and sent together: the local CPU invalidates
+*   directly and each other running CPU gets one IPI for the whole batch.  A batch which grows past
+*   \ref TLB_BATCH_MAX pages collapses into a full flush.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#ifndef __TLB_H__
+#define __TLB_H__
+
+
+
+#include "arch.h"
+#include "addr-space.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                TLB_BATCH_MAX
+*   @brief              The number of pages a batch will invalidate one at a time before flushing the whole TLB
+*///-----------------------------------------------------------------------------------------------------------------
+#define TLB_BATCH_MAX           32
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            TlbBatch_t
+*   @brief              Formalization of the \ref TlbBatch_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             TlbBatch_t
+*   @brief              A set of pending invalidations for one address space
+*
+*   `space` is the address space holding the user addresses in the batch, or `nullptr` for the kernel, whose
+*   mappings are shared by every address space.  A kernel batch goes to every CPU; a batch for `space` only goes to
+*   the CPUs in its `cpuMask`.  A CPU which is not running `space` drops the PCID it holds for it rather than
+*   invalidating its user addresses.
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct TlbBatch_t {
+    AddrSpace_t *space;                         //!< The address space; `nullptr` for the kernel
+    int count;                                  //!< The number of pages queued
+    bool full;                                  //!< Too many pages were queued; flush the whole TLB
+    Addr_t addr[TLB_BATCH_MAX];                 //!< The pages to invalidate
+} TlbBatch_t;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbBatchInit(TlbBatch_t *b, AddrSpace_t *space)
+*   @brief              Start an empty batch of invalidations
+*
+*   @param              b                   The batch
+*   @param              space               The address space the batch applies to; `nullptr` for the kernel
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void TlbBatchInit(TlbBatch_t *b, AddrSpace_t *space) {
+    b->space = space;
+    b->count = 0;
+    b->full = false;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbQueue(TlbBatch_t *b, Addr_t a)
+*   @brief              Queue a page to be invalidated when the batch is flushed
+*
+*   @param              b                   The batch
+*   @param              a                   The address of the page
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void TlbQueue(TlbBatch_t *b, Addr_t a) {
+    if (b->full) return;
+
+    if (b->count == TLB_BATCH_MAX) b->full = true;
+    else b->addr[b->count ++] = a;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbQueueAll(TlbBatch_t *b)
+*   @brief              Make the batch flush the whole TLB, for every PCID, when it is flushed
+*
+*   Needed when a paging table is replaced: its recursively-mapped address is not global and may be cached under
+*   the PCID of any address space.
+*
+*   @param              b                   The batch
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void TlbQueueAll(TlbBatch_t *b) {
+    b->full = true;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbFlush(TlbBatch_t *b)
+*   @brief              Invalidate the queued pages on every CPU which may hold them, then empty the batch
+*
+*   Returns once all the other CPUs have acknowledged the invalidation.
+*
+*   @param              b                   The batch
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbFlush(TlbBatch_t *b);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbFlushLocal(TlbBatch_t *b)
+*   @brief              Invalidate the queued pages on this CPU only, then empty the batch
+*
+*   For mappings which are only ever used by the current CPU (`PG_LOCAL`).
+*
+*   @param              b                   The batch
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbFlushLocal(TlbBatch_t *b);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbFlushPage(Addr_t a)
+*   @brief              Invalidate a single kernel page on every CPU
+*
+*   @param              a                   The address of the page
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbFlushPage(Addr_t a);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbService(void)
+*   @brief              Service the request in flight if it is pending for this CPU; interrupts must be disabled
+*
+*   Code spinning on a lock with interrupts disabled calls this while it waits, since the CPU holding the lock may
+*   itself be waiting for this CPU to acknowledge a shootdown.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbService(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbCpuOnline(void)
+*   @brief              Start including this CPU in shootdowns
+*
+*   Called on each CPU once its `gs` segment is set up; any translations cached before this point are dropped.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbCpuOnline(void);
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbShootdownHandler(void)
+*   @brief              Service a shootdown request from another CPU; called from the \ref IPI_TLB_SHOOTDOWN IPI
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbShootdownHandler(void);
+
+
+
+#endif
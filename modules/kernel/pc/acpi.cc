@@ -23,6 +23,7 @@
 #include "internals.h"
 #include "mmu.h"
 #include "cpu.h"
+#include "pmm.h"
 
 
 
@@ -205,6 +206,25 @@ typedef struct MadtLocalApic_t {
 
 
 
+/****************************************************************************************************************//**
+*   @typedef            MadtLocalX2apic_t
+*   @brief              A formalization of the Processor Local x2APIC structure
+*///-----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MadtLocalX2apic_t
+*   @brief              Processor Local x2APIC structure, used for APIC IDs which do not fit in 8 bits
+*///-----------------------------------------------------------------------------------------------------------------
+typedef struct MadtLocalX2apic_t {
+    uint8_t type;                   //!< \ref MADT_PROCESSOR_LOCAL_X2APIC
+    uint8_t len;                    //!< Length in bytes (16)
+    uint16_t reserved;              //!< Reserved
+    uint32_t x2apicId;              //!< x2APIC ID
+    uint32_t flags;                 //!< flags \note 0b00000001 means the processor is enabled
+    uint32_t procUid;               //!< ACPI Processor UID
+} PACKED MadtLocalX2apic_t;
+
+
+
 /****************************************************************************************************************//**
 *   @typedef            MadtIoApic_t
 *   @brief              A formalization of the IO APIC structure
@@ -278,6 +298,115 @@ typedef struct MadtLocalApicNMI_t {
 
 
 
+/****************************************************************************************************************//**
+*   @enum               SratType
+*   @brief              These are the types of Static Resource Affinity structures we can have
+*///-----------------------------------------------------------------------------------------------------------------
+typedef enum {
+    SRAT_PROCESSOR_LOCAL_APIC = 0,          //!< Processor Local APIC/SAPIC Affinity
+    SRAT_MEMORY = 1,                        //!< Memory Affinity
+    SRAT_PROCESSOR_LOCAL_X2APIC = 2,        //!< Processor Local x2APIC Affinity
+} SratType;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            Srat_t
+*   @brief              A formalization of the SRAT table structure
+*///-----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             Srat_t
+*   @brief              The System Resource Affinity Table (SRAT)
+*///-----------------------------------------------------------------------------------------------------------------
+typedef struct Srat_t {
+    AcpiStdHdr_t hdr;               //!< The standard ACPI table header
+    uint32_t reserved1;             //!< Reserved; must be 1
+    uint64_t reserved2;             //!< Reserved
+    uint8_t affinityStructs[0];     //!< Static Resource Allocation Structures
+} PACKED Srat_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            SratLocalApic_t
+*   @brief              A formalization of the Processor Local APIC/SAPIC Affinity structure
+*///-----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             SratLocalApic_t
+*   @brief              Processor Local APIC/SAPIC Affinity structure
+*///-----------------------------------------------------------------------------------------------------------------
+typedef struct SratLocalApic_t {
+    uint8_t type;                   //!< \ref SRAT_PROCESSOR_LOCAL_APIC
+    uint8_t len;                    //!< Length in bytes (16)
+    uint8_t proximityLo;            //!< Bits 7:0 of the proximity domain
+    uint8_t apicId;                 //!< APIC ID
+    uint32_t flags;                 //!< flags \note 0b00000001 means the entry is enabled
+    uint8_t sapicEid;               //!< Local SAPIC EID
+    uint8_t proximityHi[3];         //!< Bits 31:8 of the proximity domain
+    uint32_t clockDomain;           //!< Clock Domain
+} PACKED SratLocalApic_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            SratMemory_t
+*   @brief              A formalization of the Memory Affinity structure
+*///-----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             SratMemory_t
+*   @brief              Memory Affinity structure
+*///-----------------------------------------------------------------------------------------------------------------
+typedef struct SratMemory_t {
+    uint8_t type;                   //!< \ref SRAT_MEMORY
+    uint8_t len;                    //!< Length in bytes (40)
+    uint32_t proximity;             //!< Proximity domain
+    uint16_t reserved1;             //!< Reserved
+    uint64_t base;                  //!< Base address of the memory range
+    uint64_t length;                //!< Length of the memory range
+    uint32_t reserved2;             //!< Reserved
+    uint32_t flags;                 //!< flags \note 0b00000001 means the entry is enabled
+    uint64_t reserved3;             //!< Reserved
+} PACKED SratMemory_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            SratLocalX2apic_t
+*   @brief              A formalization of the Processor Local x2APIC Affinity structure
+*///-----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             SratLocalX2apic_t
+*   @brief              Processor Local x2APIC Affinity structure
+*///-----------------------------------------------------------------------------------------------------------------
+typedef struct SratLocalX2apic_t {
+    uint8_t type;                   //!< \ref SRAT_PROCESSOR_LOCAL_X2APIC
+    uint8_t len;                    //!< Length in bytes (24)
+    uint16_t reserved1;             //!< Reserved
+    uint32_t proximity;             //!< Proximity domain
+    uint32_t x2apicId;              //!< x2APIC ID
+    uint32_t flags;                 //!< flags \note 0b00000001 means the entry is enabled
+    uint32_t clockDomain;           //!< Clock Domain
+    uint32_t reserved2;             //!< Reserved
+} PACKED SratLocalX2apic_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            Slit_t
+*   @brief              A formalization of the SLIT table structure
+*///-----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             Slit_t
+*   @brief              The System Locality Information Table (SLIT)
+*///-----------------------------------------------------------------------------------------------------------------
+typedef struct Slit_t {
+    AcpiStdHdr_t hdr;               //!< The standard ACPI table header
+    uint64_t localities;            //!< The number of System Localities
+    uint8_t entry[0];               //!< The `localities` x `localities` distance matrix
+} PACKED Slit_t;
+
+
+
 /****************************************************************************************************************//**
 *   @var                rsdp
 *   @brief              The location of the RSDP when found
@@ -286,6 +415,24 @@ Rsdp_t *rsdp = nullptr;
 
 
 
+/****************************************************************************************************************//**
+*   @var                sratLoc
+*   @brief              The location of the SRAT, which is read once the MADT has numbered the CPUs
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+Addr_t sratLoc;
+
+
+
+/****************************************************************************************************************//**
+*   @var                cpusDropped
+*   @brief              The number of enabled CPUs in the MADT beyond \ref MAX_CPU
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+int cpusDropped;
+
+
+
 /****************************************************************************************************************//**
 *   @def                EBDA
 *   @brief              The canonical location of the Extended BIOS Data Area
@@ -322,7 +469,7 @@ Rsdp_t *rsdp = nullptr;
 *   @retval             false           The RSDP is not valid
 *   @retval             true            The RSDP is valid
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 bool IsRsdp(Rsdp_t *rsdp)
 {
     if (!rsdp) return false;
@@ -350,58 +497,33 @@ bool IsRsdp(Rsdp_t *rsdp)
 *   @retval             NULL            when the RSDP table is not found
 *   @retval             non-NULL        the address of the RSDP
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 Rsdp_t *AcpiFindRsdp(void)
 {
-    Addr_t wrk = EBDA & ~0x000f;
+    Addr_t wrk = PhysToVirt(EBDA & ~0x000f);
     Addr_t end = wrk + 1024;
-    Addr_t pg = wrk & ~(PAGE_SIZE - 1);
     Rsdp_t *rsdp;
-    Rsdp_t *rv = nullptr;
-
 
-    MapPage(pg, pg >> 12, PG_KRN);
-    if (wrk != 0) {
-        while (wrk < end) {
-            rsdp = (Rsdp_t *)wrk;
+    while (wrk < end) {
+        rsdp = (Rsdp_t *)wrk;
 
-            if (rsdp->sig.lSignature == RSDP_SIG && IsRsdp(rsdp)) {
-                rsdp = (Rsdp_t *)wrk;
-//                cmn_MmuUnmapPage(pg);
-                return rsdp;
-            }
+        if (rsdp->sig.lSignature == RSDP_SIG && IsRsdp(rsdp)) return rsdp;
 
-            wrk += 16;
-        }
+        wrk += 16;
     }
-//    cmn_MmuUnmapPage(pg);
 
-    wrk = BIOS;
-    end = BIOS_END;
-
-    for (pg = wrk; pg < end; pg += PAGE_SIZE) {
-        MapPage(pg, pg >> 12, PG_KRN);
-    }
-    pg = wrk;       // reset pg
+    wrk = PhysToVirt(BIOS);
+    end = PhysToVirt(BIOS_END);
 
     while (wrk < end) {
         rsdp = (Rsdp_t *)wrk;
 
-        if (rsdp->sig.lSignature == RSDP_SIG && IsRsdp(rsdp)) {
-            rsdp = (Rsdp_t *)wrk;
-            rv = rsdp;
-            goto exit;
-        }
+        if (rsdp->sig.lSignature == RSDP_SIG && IsRsdp(rsdp)) return rsdp;
 
         wrk += 16;
     }
 
-exit:
-    for (pg = wrk; pg < end; pg += PAGE_SIZE) {
-//        cmn_MmuUnmapPage(pg);
-    }
-
-    return rv;
+    return nullptr;
 }
 
 
@@ -417,42 +539,25 @@ exit:
 *   @retval             true            This is the desired table
 *   @retval             false           This is not the desired table
 *
-*   @note Memory must be mapped before calling
+*   @note `loc` is a physical address; the table is read through the direct map
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 bool AcpiCheckTable(Addr_t loc, uint32_t sig)
 {
     if (loc == 0) return false;
 
-    uint8_t *table = (uint8_t *)loc;
+    uint8_t *table = (uint8_t *)PhysToVirt(loc);
     uint32_t size;
     Addr_t checksum = 0;
-//    bool needUnmap = false;
-    Addr_t page = loc & ~(PAGE_SIZE - 1);
 
-//    if (!cmn_MmuIsMapped(page)) {
-        MapPage(page, page >> 12, PG_KRN);
-//        needUnmap = true;
-//    }
+    if (*((uint32_t *)table) != sig) return false;
 
-    if (*((uint32_t *)loc) != sig) {
-//        if (needUnmap) cmn_MmuUnmapPage(page);
-
-        return false;
-    }
-
-    size = *((uint32_t *)(loc + 4));
+    size = *((uint32_t *)(table + 4));
 
     for (uint32_t i = 0; i < size; i ++) {
-        Addr_t wrk = (Addr_t)(&table[i]);
-//        if (!cmn_MmuIsMapped(wrk)) {
-            MapPage(wrk, wrk >> 12, PG_KRN);
-//        }
         checksum += table[i];
     }
 
-//    if (needUnmap) cmn_MmuUnmapPage(page);
-
     return (checksum & 0xff) == 0;
 }
 
@@ -466,14 +571,14 @@ bool AcpiCheckTable(Addr_t loc, uint32_t sig)
 *
 *   @param              loc         The location of the MADT table
 *
-*   @note Memory must be mapped before calling
+*   @note `loc` is a physical address; the table is read through the direct map
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void AcpiReadMadt(Addr_t loc)
 {
-    MADT_t *madt = (MADT_t *)loc;
+    MADT_t *madt = (MADT_t *)PhysToVirt(loc);
 
-    uint8_t *wrk = (uint8_t *)(loc + __builtin_offsetof(MADT_t, intCtrlStructs));
+    uint8_t *wrk = (uint8_t *)(PhysToVirt(loc) + __builtin_offsetof(MADT_t, intCtrlStructs));
     uint8_t *first = wrk;
 
     while (wrk - first < (long)(madt->hdr.length - __builtin_offsetof(MADT_t,intCtrlStructs))) {
@@ -482,7 +587,10 @@ void AcpiReadMadt(Addr_t loc)
         switch(wrk[0]) {
         case MADT_PROCESSOR_LOCAL_APIC:
             {
-                cpuCount ++;
+                MadtLocalApic_t *apic = (MadtLocalApic_t *)wrk;
+                if (!(apic->flags & 1)) break;
+
+                if (CpuAdd(apic->apicId) < 0) cpusDropped ++;
             }
 
             break;
@@ -528,7 +636,13 @@ void AcpiReadMadt(Addr_t loc)
             break;
 
         case MADT_PROCESSOR_LOCAL_X2APIC:
-            DbgPrintf("!!!! MADT IC Table Type MADT_PROCESSOR_LOCAL_X2APIC is not supported\n");
+            {
+                MadtLocalX2apic_t *x2apic = (MadtLocalX2apic_t *)wrk;
+                if (!(x2apic->flags & 1)) break;
+
+                if (CpuAdd(x2apic->x2apicId) < 0) cpusDropped ++;
+            }
+
             break;
 
         case MADT_LOCAL_X2APIC_NMI:
@@ -555,6 +669,125 @@ void AcpiReadMadt(Addr_t loc)
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void AcpiSetCpuNode(uint32_t apicId, uint32_t proximity)
+*   @brief              Assign a CPU to the NUMA node for its proximity domain
+*
+*   @param              apicId      The APIC ID of the CPU
+*   @param              proximity   The proximity domain the CPU belongs to
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void AcpiSetCpuNode(uint32_t apicId, uint32_t proximity)
+{
+    int cpu = CpuFromApicId(apicId);
+    if (cpu < 0) return;
+
+    if (proximity >= PMM_MAX_NODES) {
+        DbgPrintf("!!!! SRAT proximity domain %u is not supported; using node 0\n", proximity);
+        proximity = 0;
+    }
+
+    CpuSetNode(cpu, proximity);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AcpiReadSrat(Addr_t loc)
+*   @brief              Read the ACPI SRAT Table to find the NUMA node for each CPU and memory range
+*
+*   Proximity domains are used directly as the NUMA node number.
+*
+*   @param              loc         The location of the SRAT table
+*
+*   @note `loc` is a physical address; the table is read through the direct map
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void AcpiReadSrat(Addr_t loc)
+{
+    Srat_t *srat = (Srat_t *)PhysToVirt(loc);
+
+    uint8_t *wrk = (uint8_t *)(PhysToVirt(loc) + __builtin_offsetof(Srat_t, affinityStructs));
+    uint8_t *first = wrk;
+
+    while (wrk - first < (long)(srat->hdr.length - __builtin_offsetof(Srat_t, affinityStructs))) {
+        uint8_t len = wrk[1];
+        if (len == 0) break;
+
+        switch(wrk[0]) {
+        case SRAT_PROCESSOR_LOCAL_APIC:
+            {
+                SratLocalApic_t *apic = (SratLocalApic_t *)wrk;
+                if (!(apic->flags & 1)) break;
+
+                uint32_t proximity = apic->proximityLo | (apic->proximityHi[0] << 8)
+                        | (apic->proximityHi[1] << 16) | ((uint32_t)apic->proximityHi[2] << 24);
+                AcpiSetCpuNode(apic->apicId, proximity);
+            }
+
+            break;
+
+        case SRAT_MEMORY:
+            {
+                SratMemory_t *mem = (SratMemory_t *)wrk;
+                if (!(mem->flags & 1)) break;
+
+                uint32_t proximity = mem->proximity;
+
+                if (proximity >= PMM_MAX_NODES) {
+                    DbgPrintf("!!!! SRAT proximity domain %u is not supported; using node 0\n", proximity);
+                    proximity = 0;
+                }
+
+                PmmAddMemoryAffinity(mem->base >> 12, (mem->base + mem->length) >> 12, proximity);
+            }
+
+            break;
+
+        case SRAT_PROCESSOR_LOCAL_X2APIC:
+            {
+                SratLocalX2apic_t *x2apic = (SratLocalX2apic_t *)wrk;
+                if (!(x2apic->flags & 1)) break;
+
+                AcpiSetCpuNode(x2apic->x2apicId, x2apic->proximity);
+            }
+
+            break;
+
+        default:
+            break;
+        }
+
+
+        wrk += len;
+    }
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AcpiReadSlit(Addr_t loc)
+*   @brief              Read the ACPI SLIT Table to find the relative distance between NUMA nodes
+*
+*   @param              loc         The location of the SLIT table
+*
+*   @note `loc` is a physical address; the table is read through the direct map
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void AcpiReadSlit(Addr_t loc)
+{
+    Slit_t *slit = (Slit_t *)PhysToVirt(loc);
+    uint64_t n = slit->localities;
+
+    for (uint64_t from = 0; from < n && from < PMM_MAX_NODES; from ++) {
+        for (uint64_t to = 0; to < n && to < PMM_MAX_NODES; to ++) {
+            PmmSetNodeDistance(from, to, slit->entry[from * n + to]);
+        }
+    }
+}
+
+
+
 /****************************************************************************************************************//**
 *   @fn                 static uint32_t AcpiGetTableSig(Addr_t loc)
 *   @brief              Get the table signature (and check its valid); return 0 if invalid
@@ -563,22 +796,14 @@ void AcpiReadMadt(Addr_t loc)
 *
 *   @param              loc         The location of the MADT table
 *
-*   @note This function will map and unmap memory as needed to satisfy access to the memory
+*   @note `loc` is a physical address; the table is read through the direct map
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 uint32_t AcpiGetTableSig(Addr_t loc)
 {
     if (!loc) return 0;
 
-//    bool needUnmap = false;
-    Addr_t page = loc & ~(PAGE_SIZE - 1);
-
-//    if (!cmn_MmuIsMapped(page)) {
-        MapPage(page, page >> 12, PG_KRN);
-//        needUnmap = true;
-//    }
-
-    uint32_t rv = *((uint32_t *)loc);
+    uint32_t rv = *((uint32_t *)PhysToVirt(loc));
 
     if (!AcpiCheckTable(loc, rv)) {
         rv = 0;
@@ -728,6 +953,7 @@ uint32_t AcpiGetTableSig(Addr_t loc)
         break;
 
     case MAKE_SIG("SLIT"):
+        AcpiReadSlit(loc);
         break;
 
     case MAKE_SIG("SPCR"):
@@ -737,6 +963,7 @@ uint32_t AcpiGetTableSig(Addr_t loc)
         break;
 
     case MAKE_SIG("SRAT"):
+        sratLoc = loc;
         break;
 
     case MAKE_SIG("SSDT"):
@@ -779,8 +1006,6 @@ uint32_t AcpiGetTableSig(Addr_t loc)
     }
 
 exit:
-//    if (needUnmap) cmn_MmuUnmapPage(page);
-
     return rv;
 }
 
@@ -800,19 +1025,16 @@ exit:
 *   @retval             true        The table at loc is the XSDT
 *   @retval             false       The table at loc is not the XSDT
 *
-*   @note This function will map and unmap memory as needed to satisfy access to the memory
+*   @note `loc` is a physical address; the table is read through the direct map
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 bool AcpiReadXsdt(Addr_t loc)
 {
     if (!loc) return false;
     bool rv = true;
-    Addr_t page = loc & ~(PAGE_SIZE - 1);
-    Xsdt_t *xsdt = (Xsdt_t *)loc;
+    Xsdt_t *xsdt = (Xsdt_t *)PhysToVirt(loc);
     uint32_t entries = 0;
 
-    MapPage(page, page >> 12, PG_KRN);
-
     if (!AcpiCheckTable(loc, MAKE_SIG("XSDT"))) {
         rv =  false;
         goto exit;
@@ -825,7 +1047,6 @@ bool AcpiReadXsdt(Addr_t loc)
     }
 
 exit:
-//    cmn_MmuUnmapPage(page);
     return rv;
 }
 
@@ -845,19 +1066,16 @@ exit:
 *   @retval             true        The table at loc is the RSDT
 *   @retval             false       The table at loc is not the RSDT
 *
-*   @note This function will map and unmap memory as needed to satisfy access to the memory
+*   @note `loc` is a physical address; the table is read through the direct map
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 bool AcpiReadRsdt(Addr_t loc)
 {
     if (!loc) return false;
     bool rv = true;
-    Addr_t page = loc & ~(PAGE_SIZE - 1);
-    Rsdt_t *rsdt = (Rsdt_t *)loc;
+    Rsdt_t *rsdt = (Rsdt_t *)PhysToVirt(loc);
     uint32_t entries = 0;
 
-    MapPage(page, page >> 12, PG_KRN);
-
     if (!AcpiCheckTable(loc, MAKE_SIG("RSDT"))) {
         rv =  false;
         goto exit;
@@ -870,7 +1088,6 @@ bool AcpiReadRsdt(Addr_t loc)
     }
 
 exit:
-//    cmn_MmuUnmapPage(page);
     return rv;
 }
 
@@ -879,13 +1096,10 @@ exit:
 /********************************************************************************************************************
 * -- Documented in arch.h
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void PlatformDiscovery(void)
 {
     rsdp = AcpiFindRsdp();
-    Addr_t page = ((Addr_t)rsdp) & ~(PAGE_SIZE - 1);
-
-    MapPage(page, page >> 12, PG_KRN);
 
     if (AcpiCheckTable(rsdp->xsdtAddress, MAKE_SIG("XSDT"))) {
         AcpiReadXsdt(rsdp->xsdtAddress);
@@ -895,25 +1109,18 @@ void PlatformDiscovery(void)
         cpuCount = 1;
     }
 
-    // -- make sure we do not exceed our capability
-    if (cpuCount > MAX_CPU) {
-        DbgPrintf("CenturyOS only supports %d CPUs\n", MAX_CPU);
-        cpuCount = MAX_CPU;
+    // -- the SRAT names CPUs by APIC ID, so it is read once the MADT has given each CPU its number
+    if (sratLoc) AcpiReadSrat(sratLoc);
+
+    // -- report any CPUs we could not number
+    if (cpusDropped) {
+        DbgPrintf("CenturyOS only supports %d CPUs; %d more are not used\n", MAX_CPU, cpusDropped);
     }
 
     if (cpuCount == 0) {
         DbgPrintf("ACPI did not report any discoverable CPUs; assuming 1 CPU\n");
         cpuCount = 1;
     }
-
-    // -- for all CPUs found, if it is not already marked at the BP, mark the CPU as off
-    for (int i = 1; i < cpuCount; i ++) {
-        if (!cpus[i].isBP) {
-            cpus[i].status = CPU_OFF;
-        }
-    }
-
-//    cmn_MmuUnmapPage(page);
 }
 
 
@@ -0,0 +1,171 @@
+/****************************************************************************************************************//**
+*   @file               framebuffer.cc
+*   @brief              The linear frame buffer set up by the boot loader
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "internals.h"
+#include "kva.h"
+#include "mboot.h"
+#include "mmu.h"
+#include "pmm.h"
+#include "framebuffer.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                FB_BLIT_ORDER
+*   @brief              The order of the block of RAM \ref FbBenchmark copies to the frame buffer (64K)
+*///-----------------------------------------------------------------------------------------------------------------
+#define FB_BLIT_ORDER       4
+
+
+
+/********************************************************************************************************************
+*   See documentation in framebuffer.h
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+Framebuffer_t framebuffer;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FbMap(int flags)
+*   @brief              Map the frame buffer at its virtual address, replacing any earlier mapping
+*
+*   The old mapping is removed and flushed first, so the frame buffer is never reachable with two memory types.
+*
+*   @param              flags               The PG_* flags which select the memory type
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FbMap(int flags)
+{
+    Addr_t page = framebuffer.base & ~(Addr_t)(PAGE_SIZE - 1);
+
+    SFENCE();
+    UnmapRange(page, framebuffer.pages);
+    MapRange(page, framebuffer.phys >> 12, framebuffer.pages, PG_KRN | PG_WRT | flags);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void FbBenchmarkPass(const char *name, uint64_t *src)
+*   @brief              Time filling and blitting the whole frame buffer with its current mapping
+*
+*   @param              name                The name of the memory type, for the report
+*   @param              src                 A block of RAM `1 << FB_BLIT_ORDER` pages long to copy from
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FbBenchmarkPass(const char *name, uint64_t *src)
+{
+    volatile uint64_t *fb = (volatile uint64_t *)framebuffer.base;
+    size_t words = ((Addr_t)framebuffer.pitch * framebuffer.height) / 8;
+    size_t srcWords = ((Addr_t)PAGE_SIZE << FB_BLIT_ORDER) / 8;
+
+    uint64_t start = RDTSC();
+
+    for (size_t i = 0; i < words; i ++) fb[i] = 0x5555555555555555;
+    SFENCE();
+
+    uint64_t fill = RDTSC() - start;
+
+    start = RDTSC();
+
+    for (size_t i = 0; i < words; i ++) fb[i] = src[i & (srcWords - 1)];
+    SFENCE();
+
+    uint64_t blit = RDTSC() - start;
+
+    DbgPrintf("FB: %s: fill %lu cycles; blit %lu cycles\n", name, fill, blit);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in framebuffer.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FbInit(void)
+{
+    MbootFramebuffer_t *tag = (MbootFramebuffer_t *)MbootFindTag(MBOOT_TAG_FRAMEBUFFER, nullptr);
+
+    // -- EGA text lives in the legacy area, which the direct map already covers uncached
+    if (!tag || tag->type == 2) return;
+
+    Addr_t offset = tag->addr & (PAGE_SIZE - 1);
+    size_t pages = (offset + ((Addr_t)tag->pitch * tag->height) + PAGE_SIZE - 1) >> 12;
+    Addr_t page = KvaAlloc(pages, 0);
+
+    if (!page) {
+        DbgPrintf("FB: unable to find address space for the frame buffer\n");
+        return;
+    }
+
+    framebuffer.phys = tag->addr;
+    framebuffer.pages = pages;
+    framebuffer.pitch = tag->pitch;
+    framebuffer.width = tag->width;
+    framebuffer.height = tag->height;
+    framebuffer.bpp = tag->bpp;
+    framebuffer.base = page + offset;
+
+    MapRange(page, tag->addr >> 12, pages, PG_KRN | PG_WRT | PG_WC);
+
+    DbgPrintf("FB: %dx%dx%d frame buffer at %p\n", (int)tag->width, (int)tag->height, (int)tag->bpp,
+            (void *)tag->addr);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in framebuffer.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FbBenchmark(void)
+{
+    if (!framebuffer.base) return;
+
+    Frame_t block = PmmAllocateOrder(FB_BLIT_ORDER, PMM_TAG_TEST);
+
+    if (!block) {
+        DbgPrintf("FB: benchmark skipped; no memory to blit from\n");
+        return;
+    }
+
+    uint64_t *src = (uint64_t *)PhysToVirt((Addr_t)block << 12);
+    size_t srcWords = ((Addr_t)PAGE_SIZE << FB_BLIT_ORDER) / 8;
+
+    for (size_t i = 0; i < srcWords; i ++) src[i] = i * 0x9e3779b97f4a7c15;
+
+    FbMap(PG_DEV);
+    FbBenchmarkPass("UC", src);
+
+    FbMap(PG_WC);
+    FbBenchmarkPass("WC", src);
+
+    volatile uint64_t *fb = (volatile uint64_t *)framebuffer.base;
+    size_t words = ((Addr_t)framebuffer.pitch * framebuffer.height) / 8;
+
+    for (size_t i = 0; i < words; i ++) fb[i] = 0;
+    SFENCE();
+
+    PmmFreeOrder(block, FB_BLIT_ORDER);
+}
+
@@ -23,6 +23,7 @@
 #include "internals.h"
 #include "mmu.h"
 #include "cpu.h"
+#include "kva.h"
 
 
 
@@ -434,14 +435,14 @@ bool CheckXapicStatus(ApicRegister_t reg, uint8_t index)
 *   @fn                 void WriteX2apicIcr(uint64_t val)
 *   @brief              Write 64-bits to the ICR register
 *
-*   Write 64-bits to the ICR register
+*   The x2APIC ICR is a single 64-bit MSR with the destination in the upper 32 bits.
 *
 *   @param              val                 The value to write to the ICR register
 *///-----------------------------------------------------------------------------------------------------------------
-INLINE
+KRN_FUNC
 void WriteX2apicIcr(uint64_t val)
 {
-    WriteX2apicRegister(APIC_ICR2, val);
+    WRMSR(GetX2apicMsr(APIC_ICR1), val);
 }
 
 
@@ -449,12 +450,15 @@ void WriteX2apicIcr(uint64_t val)
 *   @fn                 void WriteXapicIcr(uint64_t val)
 *   @brief              Write 64-bits to the ICR register
 *
-*   Write 64-bits to the ICR register
+*   Write 64-bits to the ICR register.  An IPI which is still being sent is waited out first so that IPIs can be
+*   sent back to back without losing one.
 *
 *   @param              val                 The value to write to the ICR register
 *///-----------------------------------------------------------------------------------------------------------------
 void WriteXapicIcr(uint64_t val)
 {
+    while (ReadXapicRegister(APIC_ICR1) & (1<<12)) PAUSE();     // -- delivery status: send pending
+
     uint32_t hi = (uint32_t)((val >> 32) & 0xffffffff);
     uint32_t lo = (uint32_t)(val & 0xffffffff);
 
@@ -490,7 +494,6 @@ void LapicInit(void)
 
     static int freq = 1000;
     static uint64_t factor = ~0;
-    uint32_t apicId;
 
     uint64_t apicBaseMsr = RDMSR(IA32_APIC_BASE_MSR);
     bool isBoot = (apicBaseMsr & IA32_APIC_BASE_MSR__BSP) != 0;
@@ -503,20 +506,16 @@ void LapicInit(void)
         apicOps.writeApicIcr = WriteX2apicIcr;
         apicOps.getApicId = X2apicGetId;
 
-        if (isBoot) {
-            // -- enable the APIC and x2apic mode
-            WRMSR(IA32_APIC_BASE_MSR, 0
-                    | IA32_APIC_BASE_MSR__EN
-                    | IA32_APIC_BASE_MSR__EXTD
-                    | (apicBaseMsr & ~(PAGE_SIZE-1)));
-
-            apicId = apicOps.readApicRegister(APIC_LOCAL_ID);
-
-            if (apicId > MAX_CPU) KernelPanic("APIC ID outside the supported range");
+        // -- enable the APIC and x2apic mode; each CPU has to do this for itself
+        WRMSR(IA32_APIC_BASE_MSR, 0
+                | IA32_APIC_BASE_MSR__EN
+                | IA32_APIC_BASE_MSR__EXTD
+                | (apicBaseMsr & ~(PAGE_SIZE-1)));
 
-            cpus[apicId].cpuNumber = apicId;
-            cpus[apicId].isBP = true;
-            cpus[apicId].status = CPU_RUNNING;
+        if (isBoot) {
+            CpuAdd(apicOps.readApicRegister(APIC_LOCAL_ID));
+            ThisCpu()->isBP = true;
+            ThisCpu()->status = CPU_RUNNING;
         }
     } else {
         apicOps.version = XAPIC;
@@ -528,8 +527,10 @@ void LapicInit(void)
 
         if (isBoot) {
             // -- enable the APIC
+            // -- map the registers in kernel space; the identity map goes away once boot is complete
             Frame_t apicFrame = apicBaseMsr >> 12;
-            apicOps.xApicBase = apicBaseMsr & ~(PAGE_SIZE-1);
+            apicOps.xApicBase = KvaAlloc(1, 0);
+            if (!apicOps.xApicBase) KernelPanic("Unable to allocate address space for the Local APIC");
 
             WRMSR(IA32_APIC_BASE_MSR, 0
                     | IA32_APIC_BASE_MSR__EN
@@ -537,13 +538,9 @@ void LapicInit(void)
 
             MapPage(apicOps.xApicBase, apicFrame, PG_WRT|PG_DEV|PG_KRN);
 
-            apicId = apicOps.readApicRegister(APIC_LOCAL_ID) >> 24;
-
-            if (apicId > MAX_CPU) KernelPanic("APIC ID outside the supported range");
-
-            cpus[apicId].cpuNumber = apicId;
-            cpus[apicId].isBP = true;
-            cpus[apicId].status = CPU_RUNNING;
+            CpuAdd(apicOps.readApicRegister(APIC_LOCAL_ID) >> 24);
+            ThisCpu()->isBP = true;
+            ThisCpu()->status = CPU_RUNNING;
         }
     }
 
@@ -631,6 +628,37 @@ void LapicInit(void)
 
 
 
+/****************************************************************************************************************//**
+*   see arch.h for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PitDelay(uint32_t micros)
+{
+    while (micros) {
+        // -- channel 2 counts 16 bits at 1193182 Hz, so wait at most 50ms at a time
+        uint32_t chunk = micros > 50000 ? 50000 : micros;
+        uint32_t count = (uint32_t)(((uint64_t)chunk * 1193182) / 1000000);
+        if (!count) count = 1;
+
+        // -- channel 2 in one-shot mode, gated by port 0x61 with the speaker off, as in LapicInit()
+        OUTB(0x61, (INB(0x61) & 0xfd) | 1);
+        OUTB(0x43, 0xb2);
+        OUTB(0x42, count & 0xff);
+        INB(0x60);      // short delay
+        OUTB(0x42, (count >> 8) & 0xff);
+
+        uint8_t tmp = INB(0x61) & 0xfe;
+        OUTB(0x61, tmp);
+        OUTB(0x61, tmp | 1);
+
+        while (!(INB(0x61) & 0x20)) {}  // -- busy wait here
+
+        micros -= chunk;
+    }
+}
+
+
+
 /****************************************************************************************************************//**
 *   see arch.h for documentation
 *///-----------------------------------------------------------------------------------------------------------------
@@ -656,13 +684,34 @@ void LapicEoi(void)
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 uint64_t LapicIcrDest(int core)
+*   @brief              Build the destination field of the ICR for a CPU
+*
+*   The xAPIC takes an 8-bit APIC ID in bits 56-63; the x2APIC takes the full 32-bit x2APIC ID in bits 32-63.
+*
+*   @param              core                The CPU number
+*
+*   @returns            The destination bits to OR into the ICR
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint64_t LapicIcrDest(int core)
+{
+    uint64_t apicId = CpuApicId(core);
+
+    if (apicOps.version == X2APIC) return apicId << 32;
+    else return (apicId & 0xff) << 56;
+}
+
+
+
 /****************************************************************************************************************//**
 *   see arch.h for documentation
 *///-----------------------------------------------------------------------------------------------------------------
 KRN_FUNC
 void LapicSendInit(int core)
 {
-    // -- Hi bits are xxxx xxxx 0000 0000 0000 0000 0000 0000
+    // -- Hi bits are the destination (see LapicIcrDest())
     // -- Lo bits are 0000 0000 0000 xx00 xx0x xxxx 0000 0000
     //                               ++   || | |+-+
     //                               |    || | | |
@@ -674,7 +723,7 @@ void LapicSendInit(int core)
     //
     //   or 0000 0000 0000 0000 1101 0101 0000 0000 (0x0000d500)
 
-    uint64_t icr = 0x000000000000d500 | (((uint64_t)core & 0xff) << 56);
+    uint64_t icr = 0x000000000000d500 | LapicIcrDest(core);
 
     apicOps.writeApicIcr(icr);
 }
@@ -687,7 +736,7 @@ void LapicSendInit(int core)
 KRN_FUNC
 void LapicSendSipi(int core, Addr_t vector)
 {
-    // -- Hi bits are xxxx xxxx 0000 0000 0000 0000 0000 0000
+    // -- Hi bits are the destination (see LapicIcrDest())
     // -- Lo bits are 0000 0000 0000 xx00 xx0x xxxx 0000 0000
     //                               ++   || | |+-+ +-------+
     //                               |    || | | |      +   startup vector (vector >> 12)
@@ -699,9 +748,21 @@ void LapicSendSipi(int core, Addr_t vector)
     //
     //   or 0000 0000 0000 0000 1101 0110 0000 0000 (0x0000d600)
 
-    uint64_t icr = 0x000000000000d600 | (((uint64_t)core & 0xff) << 56) | ((vector >> 12) & 0xff);
+    uint64_t icr = 0x000000000000d600 | LapicIcrDest(core) | ((vector >> 12) & 0xff);
 
     apicOps.writeApicIcr(icr);
 }
 
 
+
+/****************************************************************************************************************//**
+*   see arch.h for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void LapicSendIpi(int core, int vector)
+{
+    // -- Lo bits are 0000 0000 0000 0000 0100 0000 vvvv vvvv: fixed delivery, physical destination, edge, assert
+    uint64_t icr = 0x0000000000004000 | LapicIcrDest(core) | ((uint64_t)vector & 0xff);
+
+    apicOps.writeApicIcr(icr);
+}
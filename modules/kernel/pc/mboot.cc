@@ -0,0 +1,157 @@
+/****************************************************************************************************************//**
+*   @file               mboot.cc
+*   @brief              Access to the Multiboot 2 Information provided by the boot loader
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "internals.h"
+#include "mmu.h"
+#include "pmm.h"
+#include "mboot.h"
+
+
+
+/****************************************************************************************************************//**
+*   @var                mbiStart
+*   @brief              The physical address of the Multiboot Information structure (identity mapped)
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Addr_t mbiStart = 0;
+
+
+
+/****************************************************************************************************************//**
+*   @var                mbiEnd
+*   @brief              The ending physical address of the Multiboot Information structure (exclusive)
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Addr_t mbiEnd = 0;
+
+
+
+/********************************************************************************************************************
+*   See `mboot.h` for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void MbootInit(void)
+{
+    extern uint32_t mbSig;
+    extern uint32_t mbData;
+
+    if (mbSig != MBOOT_SIG) KernelPanic("Not booted by a Multiboot 2 compliant loader");
+
+    mbiStart = mbData;
+
+    // -- the MBI may share a page table with the kernel image, so keep the page writable
+    Addr_t page = mbiStart & ~(PAGE_SIZE - 1);
+    MapPage(page, page >> 12, PG_KRN | PG_WRT);
+
+    mbiEnd = mbiStart + *((uint32_t *)mbiStart);
+
+    MapRange(page, page >> 12, ((mbiEnd - page) + PAGE_SIZE - 1) >> 12, PG_KRN | PG_WRT);
+}
+
+
+
+/********************************************************************************************************************
+*   See `mboot.h` for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+MbootTag_t *MbootFindTag(uint32_t type, MbootTag_t *prev)
+{
+    if (!mbiStart) return nullptr;
+
+    Addr_t wrk;
+
+    if (prev) wrk = ((Addr_t)prev + prev->size + 7) & ~7;
+    else wrk = mbiStart + 8;                    // -- skip the total_size and reserved fields
+
+    while (wrk < mbiEnd) {
+        MbootTag_t *tag = (MbootTag_t *)wrk;
+
+        if (tag->type == MBOOT_TAG_END) return nullptr;
+        if (tag->type == type) return tag;
+
+        wrk = (wrk + tag->size + 7) & ~7;
+    }
+
+    return nullptr;
+}
+
+
+
+/********************************************************************************************************************
+*   See `mboot.h` for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void MbootGetRange(Addr_t *start, Addr_t *end)
+{
+    *start = mbiStart;
+    *end = mbiEnd;
+}
+
+
+
+/********************************************************************************************************************
+*   See `mboot.h` for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void MbootRelease(void)
+{
+    extern uint8_t _mbStart[];
+    extern uint8_t _dataEnd[];
+
+    if (!mbiStart) return;
+
+    Frame_t kernelStart = (Addr_t)_mbStart >> 12;
+    Frame_t kernelEnd = ((Addr_t)_dataEnd - KERNEL_BASE + PAGE_SIZE - 1) >> 12;
+    Frame_t first = mbiStart >> 12;
+    Frame_t last = (mbiEnd + PAGE_SIZE - 1) >> 12;
+    uint64_t shared = 0;
+
+
+    //
+    // -- Find the frames to keep while the module tags can still be read; a (very) large MBI keeps its tail
+    //    --------------------------------------------------------------------------------------------------
+    for (Frame_t f = first; f < last && f - first < 64; f ++) {
+        if (f >= kernelStart && f < kernelEnd) shared |= ((uint64_t)1 << (f - first));
+
+        for (MbootModule_t *mod = (MbootModule_t *)MbootFindTag(MBOOT_TAG_MODULE, nullptr); mod;
+                mod = (MbootModule_t *)MbootFindTag(MBOOT_TAG_MODULE, &mod->tag)) {
+            if (f >= (mod->modStart >> 12) && f < ((mod->modEnd + PAGE_SIZE - 1) >> 12)) {
+                shared |= ((uint64_t)1 << (f - first));
+            }
+        }
+    }
+
+
+    //
+    // -- A frame shared with the kernel image is also mapped by the kernel's own page table entry; leave it be
+    //    -----------------------------------------------------------------------------------------------------
+    for (Frame_t f = first; f < last && f - first < 64; f ++) {
+        if (shared & ((uint64_t)1 << (f - first))) continue;
+
+        UnmapPage(f << 12);
+        PmmReleaseRange(f, f + 1);
+    }
+
+    mbiStart = 0;
+    mbiEnd = 0;
+}
+
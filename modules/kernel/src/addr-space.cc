@@ -0,0 +1,279 @@
+/****************************************************************************************************************//**
+*   @file               addr-space.cc
+*   @brief              Address spaces, tagged with Process Context Identifiers where the CPU supports them
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "cpu.h"
+#include "internals.h"
+#include "pmm.h"
+#include "addr-space.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                PCID_COUNT
+*   @brief              The number of PCIDs available on each CPU
+*///-----------------------------------------------------------------------------------------------------------------
+#define PCID_COUNT          4096
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            AsCpu_t
+*   @brief              Formalization of the \ref AsCpu_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             AsCpu_t
+*   @brief              The PCID state for a single CPU
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct AsCpu_t {
+    uint64_t generation;                        //!< The current generation; starts at 1 so a tag of 0 is never valid
+    uint32_t next;                              //!< The next PCID to hand out in this generation
+    AddrSpace_t *current;                       //!< The address space this CPU is running
+} AsCpu_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                asCpu
+*   @brief              This CPU's PCID state
+*///-----------------------------------------------------------------------------------------------------------------
+PER_CPU
+static AsCpu_t asCpu;
+
+
+
+/****************************************************************************************************************//**
+*   @var                asPcid
+*   @brief              Are PCIDs in use?
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static bool asPcid;
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+AddrSpace_t kernelSpace;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AddrSpaceJoin(AddrSpace_t *s, int cpu)
+*   @brief              Add a CPU to the mask of an address space, before the CPU can load any of its translations
+*
+*   The full fence pairs with the one in \ref TlbFlush: either the sender sees this CPU in the mask, or this CPU's
+*   table walks see the sender's changes.
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void AddrSpaceJoin(AddrSpace_t *s, int cpu) {
+    __atomic_fetch_or(&s->cpuMask[cpu / 64], (uint64_t)1 << (cpu % 64), __ATOMIC_SEQ_CST);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void AddrSpaceLeave(AddrSpace_t *s, int cpu)
+*   @brief              Remove a CPU from the mask of an address space, once the CPU holds none of its translations
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void AddrSpaceLeave(AddrSpace_t *s, int cpu) {
+    __atomic_fetch_and(&s->cpuMask[cpu / 64], ~((uint64_t)1 << (cpu % 64)), __ATOMIC_RELEASE);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t AddrSpaceNewPcid(AsCpu_t *me, AddrSpace_t *s, int cpu)
+*   @brief              Hand out the next PCID on this CPU, starting a new generation when they run out
+*
+*   @param              me                  This CPU's PCID state
+*   @param              s                   The address space which gets the PCID
+*   @param              cpu                 This CPU's number
+*
+*   @returns            The PCID
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Addr_t AddrSpaceNewPcid(AsCpu_t *me, AddrSpace_t *s, int cpu)
+{
+    if (me->next == PCID_COUNT) {
+        me->generation ++;
+        me->next = 0;
+
+        // -- no PCID from the old generation may be used again until its entries are gone
+        FlushTlbAll();
+    }
+
+    Addr_t pcid = me->next ++;
+    s->tag[cpu] = (me->generation << 12) | pcid;
+
+    return pcid;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void AddrSpaceInit(void)
+{
+    ArchMmuShareKernel();
+
+    DbgPrintf("PCIDs are %s\n", asPcid ? "enabled" : "not supported");
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceCpuOnline(void)
+{
+    uint32_t a, b, c, d;
+    int cpu = ThisCpuNum();
+    AsCpu_t *me = PerCpuThis(asCpu);
+
+    CPUID(1, &a, &b, &c, &d);
+
+    if (cpu == 0) {
+        kernelSpace.pml4 = GetCr3() >> 12;
+        asPcid = ((c & CPUID_FEAT_ECX_PCID) != 0);
+    }
+
+
+    //
+    // -- The boot CR3 has PCID 0, which is required to set CR4.PCIDE; it becomes the kernel's first PCID
+    //    ------------------------------------------------------------------------------------------------
+    if (asPcid) SetCr4(GetCr4() | CR4_PCIDE);
+
+    me->generation = 1;
+    me->next = 1;
+    me->current = &kernelSpace;
+    kernelSpace.tag[cpu] = (me->generation << 12) | 0;
+    AddrSpaceJoin(&kernelSpace, cpu);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool AddrSpaceCreate(AddrSpace_t *s)
+{
+    Frame_t f = ArchMmuNewSpace();
+    if (!f) return false;
+
+    s->pml4 = f;
+    for (int i = 0; i < MAX_CPU; i ++) s->tag[i] = 0;
+    for (int i = 0; i < AS_CPU_WORDS; i ++) s->cpuMask[i] = 0;
+
+    return true;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceDestroy(AddrSpace_t *s)
+{
+    if (s == &kernelSpace || !s->pml4) return;
+
+
+    //
+    // -- Any translations left under the old PCIDs are harmless: no PCID is reused within a generation
+    //    ---------------------------------------------------------------------------------------------
+    PmmFree(s->pml4);
+
+    s->pml4 = 0;
+    for (int i = 0; i < MAX_CPU; i ++) s->tag[i] = 0;
+    for (int i = 0; i < AS_CPU_WORDS; i ++) s->cpuMask[i] = 0;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceSwitch(AddrSpace_t *s)
+{
+    Addr_t flags = DisableInterrupts();
+    int cpu = ThisCpuNum();
+    AsCpu_t *me = PerCpuThis(asCpu);
+
+    if (me->current != s) {
+        AddrSpace_t *old = me->current;
+        Addr_t cr3 = (Addr_t)s->pml4 << 12;
+
+        AddrSpaceJoin(s, cpu);
+
+        if (asPcid) {
+            uint64_t tag = s->tag[cpu];
+
+            //
+            // -- A PCID from this generation still holds only this address space's translations; a new PCID
+            //    may hold some from the address space being left, so let the CR3 write flush it
+            //    ------------------------------------------------------------------------------------------
+            if ((tag >> 12) == me->generation) cr3 |= (tag & 0xfff) | CR3_NOFLUSH;
+            else cr3 |= AddrSpaceNewPcid(me, s, cpu);
+        }
+
+        me->current = s;
+        SetCr3(cr3);
+
+        // -- without PCIDs, the CR3 write dropped every translation of the address space being left
+        if (!asPcid && old) AddrSpaceLeave(old, cpu);
+    }
+
+    RestoreInterrupts(flags);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+AddrSpace_t *AddrSpaceCurrent(void)
+{
+    return PerCpuRead(asCpu.current);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in addr-space.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void AddrSpaceDropLocal(AddrSpace_t *s)
+{
+    int cpu = ThisCpuNum();
+
+    s->tag[cpu] = 0;
+    AddrSpaceLeave(s, cpu);
+}
+
@@ -19,15 +19,73 @@
 
 
 #include "arch.h"
+#include "internals.h"
+#include "mmu.h"
+#include "pmm.h"
 #include "cpu.h"
 
 
 
+/********************************************************************************************************************
+*   See `cpu.h` for documentation
+*///----------------------------------------------------------------------------------------------------------------
+PER_CPU_FIRST
+Cpu_t cpuLocal;
+
+
+
+/****************************************************************************************************************//**
+*   @var                cpuNode
+*   @brief              The NUMA node of each CPU, recorded from the SRAT before the AP CPU structures exist
+*///----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static int cpuNode[MAX_CPU];
+
+
+
+/****************************************************************************************************************//**
+*   @def                CPU_APIC_HASH_BITS
+*   @brief              The log2 of the number of slots in \ref cpuApicHash
+*///----------------------------------------------------------------------------------------------------------------
+#define CPU_APIC_HASH_BITS  9
+
+
+
+/****************************************************************************************************************//**
+*   @def                CPU_APIC_HASH
+*   @brief              The number of slots in \ref cpuApicHash
+*///----------------------------------------------------------------------------------------------------------------
+#define CPU_APIC_HASH       (1 << CPU_APIC_HASH_BITS)
+
+static_assert(CPU_APIC_HASH >= 2 * MAX_CPU, "The APIC ID map must stay at most half full");
+
+
+
+/****************************************************************************************************************//**
+*   @var                cpuApicId
+*   @brief              The APIC ID of each CPU, by CPU number
+*///----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static uint32_t cpuApicId[MAX_CPU];
+
+
+
+/****************************************************************************************************************//**
+*   @var                cpuApicHash
+*   @brief              The map from APIC ID to CPU number: an open-addressed hash holding the CPU number plus 1
+*
+*   APIC IDs are 32 bits and sparse (they encode the package, core and thread), so they cannot index a table.
+*///----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static int cpuApicHash[CPU_APIC_HASH];
+
+
+
 /********************************************************************************************************************
 *   See `cpu.h` for documentation
 *///----------------------------------------------------------------------------------------------------------------
 KERNEL_BSS
-Cpu_t cpus[MAX_CPU];
+Cpu_t *cpus[MAX_CPU];
 
 
 
@@ -42,26 +100,78 @@ int cpuCount = 0;
 /********************************************************************************************************************
 *   See `cpu.h` for documentation
 *///----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void BpCpuInit(void)
 {
+    extern uint8_t _percpuLoad[];
+    extern uint8_t _percpuEnd[];        // -- `.percpu` is linked at 0, so this is the size of a block
+    extern uint8_t _percpuBoot[];
+
     cpuCount = 0;                       // -- start with 0 so ACPI can count them properly
 
-    cpus[0].cpu = &cpus[0];
-    cpus[0].cpuNumber = 0;
-    cpus[0].currentProcess = 0;
-    cpus[0].fenced = false;
-    cpus[0].isBP = false;               // -- will let the LAPIC make this determination
-    cpus[0].status = CPU_NONE;          // -- will let LAPIC make this determination for the BP
-
-    for (int i = 1; i < MAX_CPU; i ++) {
-        cpus[i].cpu = &cpus[i];
-        cpus[i].cpuNumber = i;
-        cpus[i].currentProcess = 0;
-        cpus[i].fenced = true;
-        cpus[i].isBP = false;
-        cpus[0].status = CPU_NONE;
+
+    //
+    // -- The BP's per-CPU block is reserved in `.bss`, since it is needed before memory can be allocated
+    //    -----------------------------------------------------------------------------------------------
+    kMemMove(_percpuBoot, _percpuLoad, (Addr_t)_percpuEnd);
+
+    Cpu_t *bootCpu = (Cpu_t *)_percpuBoot;
+    bootCpu->cpu = bootCpu;
+    bootCpu->cpuNumber = 0;
+    bootCpu->currentProcess = 0;
+    bootCpu->fenced = 0;
+    bootCpu->isBP = false;              // -- will let the LAPIC make this determination
+    bootCpu->status = CPU_NONE;         // -- will let LAPIC make this determination for the BP
+
+    cpus[0] = bootCpu;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 int CpuApicSlot(uint32_t apicId)
+*   @brief              Find the slot in \ref cpuApicHash holding an APIC ID, or the empty slot where it belongs
+*///----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+int CpuApicSlot(uint32_t apicId)
+{
+    int slot = (int)((apicId * 2654435761u) >> (32 - CPU_APIC_HASH_BITS));
+
+    while (cpuApicHash[slot] && cpuApicId[cpuApicHash[slot] - 1] != apicId) {
+        slot = (slot + 1) & (CPU_APIC_HASH - 1);
     }
+
+    return slot;
+}
+
+
+
+/********************************************************************************************************************
+*   See `cpu.h` for documentation
+*///----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+int CpuAdd(uint32_t apicId)
+{
+    int slot = CpuApicSlot(apicId);
+
+    if (cpuApicHash[slot]) return cpuApicHash[slot] - 1;
+    if (cpuCount >= MAX_CPU) return -1;
+
+    cpuApicId[cpuCount] = apicId;
+    cpuApicHash[slot] = cpuCount + 1;
+
+    return cpuCount ++;
+}
+
+
+
+/********************************************************************************************************************
+*   See `cpu.h` for documentation
+*///----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+int CpuFromApicId(uint32_t apicId)
+{
+    return cpuApicHash[CpuApicSlot(apicId)] - 1;
 }
 
 
@@ -70,8 +180,60 @@ void BpCpuInit(void)
 *   See `cpu.h` for documentation
 *///----------------------------------------------------------------------------------------------------------------
 KRN_FUNC
+uint32_t CpuApicId(int cpu)
+{
+    return cpuApicId[cpu];
+}
+
+
+
+/********************************************************************************************************************
+*   See `cpu.h` for documentation
+*///----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void CpuSetNode(int cpu, int node)
+{
+    if (cpu < 0 || cpu >= MAX_CPU) return;
+
+    cpuNode[cpu] = node;
+    if (cpus[cpu]) cpus[cpu]->node = node;
+}
+
+
+
+/********************************************************************************************************************
+*   See `cpu.h` for documentation
+*///----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
 void ApStart(void)
 {
+    extern uint8_t _percpuLoad[];
+    extern uint8_t _percpuEnd[];
+
+    if ((Addr_t)_percpuEnd > PAGE_SIZE) KernelPanic("The per-CPU section does not fit in a frame");
+
+
+    //
+    // -- Each AP's per-CPU block gets a frame of its own from the AP's node, reached through the direct map
+    //    -------------------------------------------------------------------------------------------------
+    for (int i = 1; i < cpuCount; i ++) {
+        Frame_t f = PmmAllocateNode(cpuNode[i], PMM_TAG_CPU);
+        if (!f) KernelPanic("Unable to allocate the per-CPU block for an AP");
+
+        Cpu_t *cpu = (Cpu_t *)PhysToVirt((Addr_t)f << 12);
+        kMemMove(cpu, _percpuLoad, (Addr_t)_percpuEnd);
+
+        cpu->cpu = cpu;
+        cpu->cpuNumber = i;
+        cpu->currentProcess = 0;
+        cpu->fenced = 1;
+        cpu->isBP = false;
+        cpu->status = CPU_OFF;
+        cpu->node = cpuNode[i];
+
+        cpus[i] = cpu;
+    }
+
     MoveTrampoline();
 }
 
@@ -0,0 +1,144 @@
+/****************************************************************************************************************//**
+*   @file               doorbell.cc
+*   @brief              Waiting for another CPU to change a flag, without spinning on it
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "internals.h"
+#include "doorbell.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                DOORBELL_MAX_PAUSE
+*   @brief              The most PAUSEs between 2 looks at the flag when polling
+*///-----------------------------------------------------------------------------------------------------------------
+#define DOORBELL_MAX_PAUSE  1024
+
+
+
+/****************************************************************************************************************//**
+*   @var                doorbellMwait
+*   @brief              Whether the CPUs support MONITOR/MWAIT
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static bool doorbellMwait;
+
+
+
+/********************************************************************************************************************
+*   See documentation in doorbell.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void DoorbellInit(void)
+{
+    uint32_t a, b, c, d;
+
+    CPUID(1, &a, &b, &c, &d);
+    doorbellMwait = ((c & CPUID_FEAT_ECX_MONITOR) != 0);
+
+    DbgPrintf("Waiting CPUs will %s\n", doorbellMwait ? "sleep with MONITOR/MWAIT" : "poll with PAUSE");
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool DoorbellHolds(volatile int *bell, int value, bool until)
+*   @brief              Does the waiter still need to wait?
+*
+*   @param              bell                The flag
+*   @param              value               The value compared against
+*   @param              until               Wait until the flag holds the value, rather than while it does
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+bool DoorbellHolds(volatile int *bell, int value, bool until) {
+    return (__atomic_load_n(bell, __ATOMIC_ACQUIRE) == value) != until;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void DoorbellSleep(volatile int *bell, int value, bool until)
+*   @brief              Wait on a flag for \ref DoorbellWait and \ref DoorbellWaitUntil
+*
+*   @param              bell                The flag
+*   @param              value               The value compared against
+*   @param              until               Wait until the flag holds the value, rather than while it does
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_CODE static
+void DoorbellSleep(volatile int *bell, int value, bool until)
+{
+    //
+    // -- The flag is checked again once the monitor is armed, or a write between the 2 would be slept through
+    //    -----------------------------------------------------------------------------------------------------
+    if (doorbellMwait) {
+        while (DoorbellHolds(bell, value, until)) {
+            MONITOR(bell);
+            if (!DoorbellHolds(bell, value, until)) break;
+            MWAIT();
+        }
+
+        return;
+    }
+
+
+    //
+    // -- Otherwise poll, doubling the PAUSEs between looks up to a limit
+    //    ---------------------------------------------------------------
+    int pauses = 1;
+
+    while (DoorbellHolds(bell, value, until)) {
+        for (int i = 0; i < pauses; i ++) PAUSE();
+        if (pauses < DOORBELL_MAX_PAUSE) pauses <<= 1;
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in doorbell.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void DoorbellWait(volatile int *bell, int value)
+{
+    DoorbellSleep(bell, value, false);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in doorbell.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void DoorbellWaitUntil(volatile int *bell, int value)
+{
+    DoorbellSleep(bell, value, true);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in doorbell.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void DoorbellRing(volatile int *bell, int value)
+{
+    __atomic_store_n(bell, value, __ATOMIC_RELEASE);
+}
+
@@ -0,0 +1,213 @@
+/****************************************************************************************************************//**
+*   @file               frame.cc
+*   @brief              Per-frame descriptors
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "internals.h"
+#include "mboot.h"
+#include "mmu.h"
+#include "pmm.h"
+#include "frame.h"
+
+
+
+/****************************************************************************************************************//**
+*   @var                frameDescReady
+*   @brief              Has the frame descriptor array been built?
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static bool frameDescReady = false;
+
+
+
+/********************************************************************************************************************
+*   See documentation in frame.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FrameDescInit(void)
+{
+    MbootMmap_t *mmap = (MbootMmap_t *)MbootFindTag(MBOOT_TAG_MMAP, nullptr);
+    if (!mmap) KernelPanic("The boot loader did not provide a memory map");
+
+    Addr_t mmapEnd = (Addr_t)mmap + mmap->tag.size;
+    uint64_t pages = 0;
+
+    for (Addr_t e = (Addr_t)mmap->entries; e < mmapEnd; e += mmap->entrySize) {
+        MbootMmapEntry_t *entry = (MbootMmapEntry_t *)e;
+        if (entry->type != MBOOT_MEM_AVAILABLE) continue;
+
+        Frame_t start = (entry->addr + PAGE_SIZE - 1) >> 12;
+        Frame_t end = (entry->addr + entry->len) >> 12;
+        if (start >= end) continue;
+
+
+        //
+        // -- Back only the part of the array which describes this range; neighbors may share a page
+        //    --------------------------------------------------------------------------------------
+        Addr_t first = (Addr_t)FrameGetDesc(start) & ~(PAGE_SIZE - 1);
+        Addr_t last = (Addr_t)FrameGetDesc(end);
+
+        for (Addr_t page = first; page < last; page += PAGE_SIZE) {
+            if (IsMapped(page)) continue;
+
+            Frame_t f = PmmAllocate(PMM_TAG_FRAME_DESC);
+            if (!f) KernelPanic("Unable to allocate a frame for the frame descriptors");
+
+            MapPage(page, f, PG_KRN | PG_WRT);
+
+            uint64_t *wrk = (uint64_t *)page;
+            for (int i = 0; i < 512; i ++) wrk[i] = 0;
+            pages ++;
+        }
+
+        for (Frame_t f = start; f < end; f ++) FrameGetDesc(f)->flags = FRAME_PRESENT;
+    }
+
+    frameDescReady = true;
+
+    DbgPrintf("Frame descriptors use %lu pages\n", pages);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in frame.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void FrameSetNode(Frame_t start, Frame_t end, int node)
+{
+    if (!frameDescReady) return;
+
+    MbootMmap_t *mmap = (MbootMmap_t *)MbootFindTag(MBOOT_TAG_MMAP, nullptr);
+    if (!mmap) return;
+
+    Addr_t mmapEnd = (Addr_t)mmap + mmap->tag.size;
+
+    for (Addr_t e = (Addr_t)mmap->entries; e < mmapEnd; e += mmap->entrySize) {
+        MbootMmapEntry_t *entry = (MbootMmapEntry_t *)e;
+        if (entry->type != MBOOT_MEM_AVAILABLE) continue;
+
+        Frame_t s = (entry->addr + PAGE_SIZE - 1) >> 12;
+        Frame_t t = (entry->addr + entry->len) >> 12;
+
+        if (s < start) s = start;
+        if (t > end) t = end;
+
+        for (Frame_t f = s; f < t; f ++) FrameGetDesc(f)->node = node;
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in frame.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void FrameOnAlloc(Frame_t f, int order, int owner)
+{
+    if (!frameDescReady) return;
+
+    for (Frame_t i = 0; i < ((Frame_t)1 << order); i ++) {
+        FrameDesc_t *desc = FrameGetDesc(f + i);
+
+        desc->refCount = 1;
+        desc->flags = FRAME_PRESENT;
+        desc->owner = owner;
+        desc->lruNext = 0;
+        desc->lruPrev = 0;
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in frame.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+int FrameOnFree(Frame_t f, int order)
+{
+    if (!frameDescReady) return 0;
+
+    int rv = FrameGetDesc(f)->owner;
+
+    for (Frame_t i = 0; i < ((Frame_t)1 << order); i ++) {
+        FrameDesc_t *desc = FrameGetDesc(f + i);
+
+        // -- the caller may hold the only reference; a shared frame must be given up with FrameRelease()
+        if (desc->refCount > 1) KernelPanic("A frame which is still shared was freed");
+
+        desc->refCount = 0;
+        desc->flags = FRAME_PRESENT;
+        desc->owner = 0;
+    }
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in frame.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void FrameAddRef(Frame_t f)
+{
+    if (!frameDescReady) return;
+
+    __atomic_add_fetch(&FrameGetDesc(f)->refCount, 1, __ATOMIC_RELAXED);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in frame.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool FrameRelease(Frame_t f)
+{
+    if (!frameDescReady) return false;
+
+    FrameDesc_t *desc = FrameGetDesc(f);
+
+    if (desc->refCount == 0) {
+        DbgPrintf("Frame %lu is not referenced and cannot be released\n", f);
+        return false;
+    }
+
+    if (__atomic_sub_fetch(&desc->refCount, 1, __ATOMIC_ACQ_REL) != 0) return false;
+
+    PmmFree(f);
+    return true;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in frame.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool FrameIsAvailable(Frame_t f)
+{
+    if (!frameDescReady) return false;
+    if (!IsMapped((Addr_t)FrameGetDesc(f))) return false;
+
+    return (FrameGetDesc(f)->flags & FRAME_PRESENT) != 0;
+}
+
@@ -23,16 +23,60 @@
 
 #include "arch.h"
 #include "internals.h"
+#include "addr-space.h"
+#include "kva.h"
+#include "lazy.h"
 #include "cpu.h"
+#include "mmu.h"
+#include "mboot.h"
+#include "pmm.h"
+#include "frame.h"
+#include "framebuffer.h"
+#include "doorbell.h"
 
 
 /********************************************************************************************************************
 *   See `internals.h` for documentation
 *///-----------------------------------------------------------------------------------------------------------------
-EXTERNC void EarlyInit(void)
+INIT_FUNC
+void EarlyInit(void)
 {
     BpCpuInit();
+    KvaInit();
     ArchEarlyInit();
+    PmmInit();
+    FrameDescInit();
+    MmuDirectMapInit();
+    AddrSpaceInit();
+    LazyInit();
+    DoorbellInit();
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ReleaseInitMemory(void)
+*   @brief              Return the memory which is only used during boot to the PMM
+*
+*   This is called once all the APs are running.  It must not itself be in the `.kinit` section, and nothing in
+*   `.kinit` may be called once it has run.
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ReleaseInitMemory(void)
+{
+    extern uint8_t _kinitStart[];
+    extern uint8_t _kinitEnd[];
+
+    uint64_t before = PmmFreeCount();
+
+    // -- the MBI is only reachable through the identity map, which ArchReleaseBootMemory() drops
+    MbootRelease();
+    ArchReleaseBootMemory();
+
+    UnmapRange((Addr_t)_kinitStart, ((Addr_t)_kinitEnd - (Addr_t)_kinitStart + PAGE_SIZE - 1) >> 12);
+    PmmReleaseRange(((Addr_t)_kinitStart - KERNEL_BASE) >> 12, ((Addr_t)_kinitEnd - KERNEL_BASE) >> 12);
+
+    DbgPrintf("Released %lu frames of boot-only memory\n", PmmFreeCount() - before);
 }
 
 
@@ -52,12 +96,22 @@ void kInit(void)
     DbgPrintf("Hello, World!\n");
 
     PlatformDiscovery();
+    PmmInitZones();
+    PmmInitColors();
+    PmmColorBenchmark();
+    FbInit();
+    FbBenchmark();
 
     ApStart();
+    ReleaseInitMemory();
+    PmmDumpStats();
 
     EnableInterrupts();
 
-    while (true) {}
+    // -- while there is nothing else to do, keep the pool of zeroed frames and the paging table cache full
+    while (true) {
+        if (!PmmZeroIdle() && !ArchMmuTableIdle()) PAUSE();
+    }
 }
 
 
@@ -70,15 +124,18 @@ void kInitAp(void)
 {
     ArchApInit();
 
-    DbgPrintf("Hello, World from CPU%d\n", LapicGetId());
-    cpus[LapicGetId()].status = CPU_FENCED;
+    DbgPrintf("Hello, World from CPU%d\n", ThisCpuNum());
+    DoorbellRing(&ThisCpu()->status, CPU_FENCED);
 
     EnableInterrupts();
 
-    // -- Hold this CPU here until it is released to start scheduling
-    while (cpus[LapicGetId()].status == CPU_FENCED) {}
+    // -- Fill the pool of zeroed frames and the paging table cache, then sleep here until released to schedule;
+    //    the doorbell is `fenced`, since the interrupt stubs save and restore `status` and `prevStatus` (bytes
+    //    24-31 of Cpu_t) over any store to them
+    while (PerCpuRead(cpuLocal.fenced) && (PmmZeroIdle() || ArchMmuTableIdle())) {}
+    DoorbellWait(&ThisCpu()->fenced, 1);
 
     // -- Currently will never get here
-    while (true){}
+    while (true) HLT();
 }
 
@@ -44,7 +44,7 @@ void KernelPanic(const char *msg)
         "CPU_SERVICE",
     };
 
-    int context = cpus[ThisCpuNum()].status;
+    int context = PerCpuRead(cpuLocal.status);
 
     DbgPrintf(ANSI_BG_RED ANSI_FG_WHITE ANSI_ATTR_BOLD ANSI_CLEAR ANSI_SET_CURSOR(0,0));
     DbgPrintf("─────[ %-35s ]────────────────────────────────────────────────────────────────\n", msg);
@@ -0,0 +1,489 @@
+/****************************************************************************************************************//**
+*   @file               kva.cc
+*   @brief              The kernel virtual address space allocator
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   Every range, whatever its state, is on a list in address order so that a freed range can be merged with free
+*   neighbors.  Each range is also on one other list: its size list when free, a hash bucket when allocated, the
+*   purge list when waiting for a purge, or the spare list when the descriptor is not in use.
+*
+*   The lock is taken with interrupts enabled: a purge waits for other CPUs to acknowledge the shootdown, and a CPU
+*   waiting for the lock must still be able to take the IPI.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "internals.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "tlb.h"
+#include "kva.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                KVA_MAX_RANGES
+*   @brief              The number of range descriptors, which limits how fragmented the KVA region can become
+*///-----------------------------------------------------------------------------------------------------------------
+#define KVA_MAX_RANGES      1024
+
+
+
+/****************************************************************************************************************//**
+*   @def                KVA_CLASSES
+*   @brief              The number of size lists; list `n` holds free ranges of 2^n to 2^(n+1)-1 pages
+*///-----------------------------------------------------------------------------------------------------------------
+#define KVA_CLASSES         32
+
+
+
+/****************************************************************************************************************//**
+*   @def                KVA_HASH
+*   @brief              The number of hash buckets for allocated ranges
+*///-----------------------------------------------------------------------------------------------------------------
+#define KVA_HASH            64
+
+
+
+/****************************************************************************************************************//**
+*   @def                KVA_LAZY_MAX
+*   @brief              The number of freed pages which may wait for a purge (32M of address space)
+*///-----------------------------------------------------------------------------------------------------------------
+#define KVA_LAZY_MAX        8192
+
+
+
+/********************************************************************************************************************
+*   The states of a range
+*///-----------------------------------------------------------------------------------------------------------------
+enum {
+    KVA_SPARE = 0,                      //!< The descriptor is not in use
+    KVA_FREE,                           //!< The range is available
+    KVA_BUSY,                           //!< The range is allocated
+    KVA_LAZY,                           //!< The range was freed and is waiting for a purge
+};
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            KvaRange_t
+*   @brief              Formalization of the \ref KvaRange_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             KvaRange_t
+*   @brief              A range of the KVA region; the guard page, if any, is the first page of the range
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct KvaRange_t {
+    Addr_t start;                               //!< The address of the first page, including any guard page
+    size_t pages;                               //!< The number of pages, including any guard page
+    int state;                                  //!< The KVA_* state
+    bool guard;                                 //!< The first page is a guard page
+    struct KvaRange_t *addrNext;                //!< The next range in address order
+    struct KvaRange_t *addrPrev;                //!< The previous range in address order
+    struct KvaRange_t *next;                    //!< The next range on the size, hash, purge or spare list
+    struct KvaRange_t *prev;                    //!< The previous range on the size or hash list
+} KvaRange_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaRanges
+*   @brief              The range descriptors
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static KvaRange_t kvaRanges[KVA_MAX_RANGES];
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaSpare
+*   @brief              The descriptors not in use
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static KvaRange_t *kvaSpare;
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaFree
+*   @brief              The free ranges, by size
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static KvaRange_t *kvaFree[KVA_CLASSES];
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaFreeMask
+*   @brief              A bit for each size list which is not empty
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static uint32_t kvaFreeMask;
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaBusy
+*   @brief              The allocated ranges, hashed on their usable address
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static KvaRange_t *kvaBusy[KVA_HASH];
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaLazy
+*   @brief              The freed ranges waiting for a purge
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static KvaRange_t *kvaLazy;
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaLazyPages
+*   @brief              The number of pages waiting for a purge
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static size_t kvaLazyPages;
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaBatch
+*   @brief              The invalidations for the ranges waiting for a purge
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static TlbBatch_t kvaBatch;
+
+
+
+/****************************************************************************************************************//**
+*   @var                kvaLock
+*   @brief              Protects all the KVA allocator state
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Spinlock_t kvaLock;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 int KvaClass(size_t pages)
+*   @brief              Get the size list for a number of pages
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+int KvaClass(size_t pages) {
+    return 31 - __builtin_clz(pages);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 int KvaHash(Addr_t a)
+*   @brief              Get the hash bucket for an allocated range
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+int KvaHash(Addr_t a) {
+    return (a >> 12) % KVA_HASH;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t KvaUsable(KvaRange_t *r)
+*   @brief              Get the address of the first usable page of a range
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+Addr_t KvaUsable(KvaRange_t *r) {
+    return r->start + (r->guard ? PAGE_SIZE : 0);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaLink(KvaRange_t **head, KvaRange_t *r)
+*   @brief              Push a range on a doubly-linked size or hash list
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void KvaLink(KvaRange_t **head, KvaRange_t *r) {
+    r->prev = nullptr;
+    r->next = *head;
+    if (*head) (*head)->prev = r;
+    *head = r;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaUnlink(KvaRange_t **head, KvaRange_t *r)
+*   @brief              Remove a range from a doubly-linked size or hash list
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void KvaUnlink(KvaRange_t **head, KvaRange_t *r) {
+    if (r->prev) r->prev->next = r->next;
+    else *head = r->next;
+
+    if (r->next) r->next->prev = r->prev;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaAddFree(KvaRange_t *r)
+*   @brief              Put a range on its size list
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaAddFree(KvaRange_t *r)
+{
+    int c = KvaClass(r->pages);
+
+    r->state = KVA_FREE;
+    r->guard = false;
+    KvaLink(&kvaFree[c], r);
+    kvaFreeMask |= (1u << c);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaRemoveFree(KvaRange_t *r)
+*   @brief              Take a range off its size list
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaRemoveFree(KvaRange_t *r)
+{
+    int c = KvaClass(r->pages);
+
+    KvaUnlink(&kvaFree[c], r);
+    if (!kvaFree[c]) kvaFreeMask &= ~(1u << c);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaRelease(KvaRange_t *r)
+*   @brief              Drop a range which has been merged into its neighbor and return its descriptor
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaRelease(KvaRange_t *r)
+{
+    if (r->addrPrev) r->addrPrev->addrNext = r->addrNext;
+    if (r->addrNext) r->addrNext->addrPrev = r->addrPrev;
+
+    r->state = KVA_SPARE;
+    r->next = kvaSpare;
+    kvaSpare = r;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 KvaRange_t *KvaFindFree(size_t pages)
+*   @brief              Find the first free range large enough, looking only at the size lists which can hold one
+*
+*   @param              pages               The number of pages needed
+*
+*   @returns            The range, still on its size list; `nullptr` if there is none
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+KvaRange_t *KvaFindFree(size_t pages)
+{
+    int c = KvaClass(pages);
+
+    // -- only some of the ranges on the list for this size are large enough
+    for (KvaRange_t *r = kvaFree[c]; r; r = r->next) {
+        if (r->pages >= pages) return r;
+    }
+
+    // -- every range on any larger list will do
+    uint32_t mask = (c == KVA_CLASSES - 1 ? 0 : kvaFreeMask & ~((2u << c) - 1));
+    if (!mask) return nullptr;
+
+    return kvaFree[__builtin_ctz(mask)];
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void KvaPurgeLocked(void)
+*   @brief              Purge the ranges waiting for one; the lock must be held
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaPurgeLocked(void)
+{
+    if (!kvaLazy) return;
+
+    TlbFlush(&kvaBatch);
+
+    while (kvaLazy) {
+        KvaRange_t *r = kvaLazy;
+        kvaLazy = r->next;
+
+
+        //
+        // -- Merge with any free neighbors
+        //    -----------------------------
+        KvaRange_t *n = r->addrNext;
+        if (n && n->state == KVA_FREE) {
+            KvaRemoveFree(n);
+            r->pages += n->pages;
+            KvaRelease(n);
+        }
+
+        KvaRange_t *p = r->addrPrev;
+        if (p && p->state == KVA_FREE) {
+            KvaRemoveFree(p);
+            p->pages += r->pages;
+            KvaRelease(r);
+            r = p;
+        }
+
+        KvaAddFree(r);
+    }
+
+    kvaLazyPages = 0;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in kva.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void KvaInit(void)
+{
+    for (int i = 1; i < KVA_MAX_RANGES; i ++) {
+        kvaRanges[i].state = KVA_SPARE;
+        kvaRanges[i].next = kvaSpare;
+        kvaSpare = &kvaRanges[i];
+    }
+
+    KvaRange_t *r = &kvaRanges[0];
+    r->start = KVA_ADDR;
+    r->pages = KVA_SIZE >> 12;
+    r->addrNext = nullptr;
+    r->addrPrev = nullptr;
+    KvaAddFree(r);
+
+    TlbBatchInit(&kvaBatch, nullptr);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in kva.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Addr_t KvaAlloc(size_t pages, int flags)
+{
+    if (pages == 0) return 0;
+
+    bool guard = ((flags & KVA_GUARD) != 0);
+    size_t need = pages + (guard ? 1 : 0);
+
+    SpinLock(&kvaLock);
+
+    KvaRange_t *r = KvaFindFree(need);
+
+    if (!r && kvaLazy) {
+        KvaPurgeLocked();
+        r = KvaFindFree(need);
+    }
+
+    if (!r) {
+        SpinUnlock(&kvaLock);
+        return 0;
+    }
+
+    KvaRemoveFree(r);
+
+
+    //
+    // -- Split off what is not needed; without a spare descriptor, the caller gets the whole range
+    //    -----------------------------------------------------------------------------------------
+    if (r->pages > need && kvaSpare) {
+        KvaRange_t *rest = kvaSpare;
+        kvaSpare = rest->next;
+
+        rest->start = r->start + ((Addr_t)need * PAGE_SIZE);
+        rest->pages = r->pages - need;
+        rest->addrPrev = r;
+        rest->addrNext = r->addrNext;
+        if (r->addrNext) r->addrNext->addrPrev = rest;
+        r->addrNext = rest;
+
+        r->pages = need;
+        KvaAddFree(rest);
+    }
+
+    r->state = KVA_BUSY;
+    r->guard = guard;
+
+    Addr_t rv = KvaUsable(r);
+    KvaLink(&kvaBusy[KvaHash(rv)], r);
+
+    SpinUnlock(&kvaLock);
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in kva.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaFree(Addr_t a)
+{
+    SpinLock(&kvaLock);
+
+    KvaRange_t *r = kvaBusy[KvaHash(a)];
+    while (r && KvaUsable(r) != a) r = r->next;
+
+    if (!r) {
+        SpinUnlock(&kvaLock);
+        DbgPrintf("KVA: %p was not allocated\n", (void *)a);
+        return;
+    }
+
+    KvaUnlink(&kvaBusy[KvaHash(a)], r);
+
+    UnmapRangeDeferred(r->start, r->pages, &kvaBatch);
+
+    r->state = KVA_LAZY;
+    r->next = kvaLazy;
+    kvaLazy = r;
+    kvaLazyPages += r->pages;
+
+    if (kvaLazyPages >= KVA_LAZY_MAX) KvaPurgeLocked();
+
+    SpinUnlock(&kvaLock);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in kva.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void KvaPurge(void)
+{
+    SpinLock(&kvaLock);
+    KvaPurgeLocked();
+    SpinUnlock(&kvaLock);
+}
+
@@ -0,0 +1,297 @@
+/****************************************************************************************************************//**
+*   @file               lazy.cc
+*   @brief              Regions of virtual memory which are backed by frames only when they are first touched
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "internals.h"
+#include "pmm.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "tlb.h"
+#include "addr-space.h"
+#include "lazy.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                LAZY_MAX_REGIONS
+*   @brief              The number of lazy regions which may be registered at once
+*///-----------------------------------------------------------------------------------------------------------------
+#define LAZY_MAX_REGIONS    64
+
+
+
+/****************************************************************************************************************//**
+*   @def                LAZY_FREE_MAX
+*   @brief              The number of frames \ref LazyRelease unmaps before flushing the TLB and freeing them
+*///-----------------------------------------------------------------------------------------------------------------
+#define LAZY_FREE_MAX       32
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            LazyRegion_t
+*   @brief              Formalization of the \ref LazyRegion_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             LazyRegion_t
+*   @brief              A registered lazy region; the slot is unused when `pages` is 0
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct LazyRegion_t {
+    Addr_t start;                               //!< The first page of the region
+    size_t pages;                               //!< The number of pages in the region
+    int flags;                                  //!< The PG_* flags for the pages once they are mapped
+    AddrSpace_t *space;                         //!< The address space for a user region; `nullptr` for the kernel
+} LazyRegion_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                lazyRegions
+*   @brief              The registered lazy regions
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static LazyRegion_t lazyRegions[LAZY_MAX_REGIONS];
+
+
+
+/****************************************************************************************************************//**
+*   @var                lazyLock
+*   @brief              Protects \ref lazyRegions and serializes resolving faults
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Spinlock_t lazyLock;
+
+
+
+/****************************************************************************************************************//**
+*   @var                lazyZero
+*   @brief              The frame of zeros shared by all the pages which have only been read from user mode
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Frame_t lazyZero;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 LazyRegion_t *LazyFind(Addr_t a, AddrSpace_t *space)
+*   @brief              Find the region holding an address; \ref lazyLock must be held
+*
+*   @param              a                   The address
+*   @param              space               The address space for a user address; `nullptr` for the kernel
+*
+*   @returns            The region; `nullptr` if the address is not in a lazy region
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_CODE
+static LazyRegion_t *LazyFind(Addr_t a, AddrSpace_t *space)
+{
+    for (int i = 0; i < LAZY_MAX_REGIONS; i ++) {
+        LazyRegion_t *r = &lazyRegions[i];
+
+        if (r->pages && r->space == space && a >= r->start && a - r->start < (Addr_t)r->pages * PAGE_SIZE) return r;
+    }
+
+    return nullptr;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void LazyMapFrame(Addr_t a, int flags)
+*   @brief              Map a newly allocated frame of zeros at a page, replacing any mapping of the zero frame
+*
+*   @param              a                   The page
+*   @param              flags               The PG_* flags for the page
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_CODE
+static void LazyMapFrame(Addr_t a, int flags)
+{
+    Frame_t f = PmmAllocateZeroed(PMM_TAG_DEMAND);
+
+    if (!f) {
+        f = PmmAllocate(PMM_TAG_DEMAND);
+        if (!f) KernelPanic("Out of memory backing a lazy region");
+
+        uint64_t *page = (uint64_t *)PhysToVirt((Addr_t)f << 12);
+        for (int i = 0; i < 512; i ++) page[i] = 0;
+    }
+
+    MapPage(a, f, flags);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void LazyFreeFrames(Frame_t *frames, int count, TlbBatch_t *batch)
+*   @brief              Flush the unmapped pages from every TLB, then free their frames
+*
+*   @param              frames              The frames which were unmapped
+*   @param              count               The number of frames
+*   @param              batch               The invalidations for the unmapped pages
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_CODE
+static void LazyFreeFrames(Frame_t *frames, int count, TlbBatch_t *batch)
+{
+    TlbFlush(batch);
+
+    for (int i = 0; i < count; i ++) PmmFree(frames[i]);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in lazy.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void LazyInit(void)
+{
+    Frame_t f = PmmAllocate(PMM_TAG_DEMAND);
+    if (!f) KernelPanic("Unable to allocate the shared zero frame");
+
+    uint64_t *page = (uint64_t *)PhysToVirt((Addr_t)f << 12);
+    for (int i = 0; i < 512; i ++) page[i] = 0;
+
+    lazyZero = f;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in lazy.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool LazyRegister(Addr_t a, size_t pages, int flags)
+{
+    if (!pages || (a & (PAGE_SIZE - 1))) return false;
+
+    AddrSpace_t *space = (a < USER_SPACE_END ? AddrSpaceCurrent() : nullptr);
+    bool rv = false;
+
+    SpinLock(&lazyLock);
+
+    for (int i = 0; i < LAZY_MAX_REGIONS; i ++) {
+        LazyRegion_t *r = &lazyRegions[i];
+        if (r->pages) continue;
+
+        r->start = a;
+        r->flags = flags;
+        r->space = space;
+        r->pages = pages;
+        rv = true;
+        break;
+    }
+
+    SpinUnlock(&lazyLock);
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in lazy.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void LazyRelease(Addr_t a)
+{
+    AddrSpace_t *space = (a < USER_SPACE_END ? AddrSpaceCurrent() : nullptr);
+    size_t pages = 0;
+
+    SpinLock(&lazyLock);
+
+    LazyRegion_t *r = LazyFind(a, space);
+    if (r && r->start == a) {
+        pages = r->pages;
+        r->pages = 0;
+    }
+
+    SpinUnlock(&lazyLock);
+
+
+    //
+    // -- Only the pages which were touched are mapped; the shared zero frame is never freed
+    //    ----------------------------------------------------------------------------------
+    TlbBatch_t batch;
+    Frame_t frames[LAZY_FREE_MAX];
+    int count = 0;
+
+    TlbBatchInit(&batch, space);
+
+    for (size_t i = 0; i < pages; i ++) {
+        Addr_t page = a + ((Addr_t)i * PAGE_SIZE);
+        Addr_t phys = VirtToPhys(page);
+
+        if (!phys) continue;
+
+        UnmapRangeDeferred(page, 1, &batch);
+        if ((phys >> 12) != lazyZero) frames[count ++] = phys >> 12;
+
+        if (count == LAZY_FREE_MAX) {
+            LazyFreeFrames(frames, count, &batch);
+            count = 0;
+        }
+    }
+
+    LazyFreeFrames(frames, count, &batch);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in lazy.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void LazyPageFault(Addr_t a, uint64_t err)
+{
+    Addr_t page = a & ~(Addr_t)(PAGE_SIZE - 1);
+    AddrSpace_t *space = (a < USER_SPACE_END ? AddrSpaceCurrent() : nullptr);
+
+
+    //
+    // -- Interrupts are disabled here, so keep answering shootdowns: the CPU holding the lock may be waiting on us
+    //    ---------------------------------------------------------------------------------------------------------
+    while (!SpinTryLock(&lazyLock)) {
+        TlbService();
+        PAUSE();
+    }
+
+    LazyRegion_t *r = LazyFind(page, space);
+
+    if (!r || ((err & PF_USER) && !space) || ((err & PF_WRITE) && !(r->flags & PG_WRT))) {
+        SpinUnlock(&lazyLock);
+        DbgPrintf("\nPage fault at %p (error %d)\n", (void *)a, (int)err);
+        KernelPanic("#PF -- Page Fault");
+    }
+
+    Addr_t phys = VirtToPhys(page);
+
+    if (!phys) {
+        if ((err & (PF_USER | PF_WRITE)) == PF_USER) MapPage(page, lazyZero, r->flags & ~PG_WRT);
+        else LazyMapFrame(page, r->flags);
+    } else if ((err & PF_WRITE) && (phys >> 12) == lazyZero) {
+        LazyMapFrame(page, r->flags);
+    } else {
+        // -- another CPU resolved the fault first; drop any stale translation and retry the access
+        INVLPG(page);
+    }
+
+    SpinUnlock(&lazyLock);
+}
+
@@ -22,6 +22,17 @@
 
 
 #include "arch.h"
+#include "internals.h"
+#include "mboot.h"
+#include "mmu.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                LEGACY_END
+*   @brief              The end of the legacy first 1M, where the BIOS data areas and firmware tables live
+*///-----------------------------------------------------------------------------------------------------------------
+#define LEGACY_END      0x100000
 
 
 
@@ -37,3 +48,112 @@ void MapPage(Addr_t a, Frame_t f, int flags)
 }
 
 
+
+/********************************************************************************************************************
+*   See documentation in mmu.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool IsMapped(Addr_t a)
+{
+    return ArchMmuIsMapped(a);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in mmu.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void UnmapPage(Addr_t a)
+{
+    ArchMmuUnmapPage(a);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in mmu.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void MapRange(Addr_t a, Frame_t f, size_t count, int flags)
+{
+    if (a == 0 || count == 0) return;
+    ArchMmuMapRange(a, f, count, flags);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in mmu.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void UnmapRange(Addr_t a, size_t count)
+{
+    if (count == 0) return;
+    ArchMmuUnmapRange(a, count);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in mmu.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void UnmapRangeDeferred(Addr_t a, size_t count, TlbBatch_t *batch)
+{
+    if (count == 0) return;
+    ArchMmuUnmapRangeDeferred(a, count, batch);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in mmu.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void MmuDirectMapInit(void)
+{
+    MbootMmap_t *mmap = (MbootMmap_t *)MbootFindTag(MBOOT_TAG_MMAP, nullptr);
+    if (!mmap) KernelPanic("The boot loader did not provide a memory map");
+
+    Addr_t mmapEnd = (Addr_t)mmap + mmap->tag.size;
+    uint64_t ram = 0;
+
+
+    //
+    // -- The BIOS areas searched for the RSDP are not always described by the memory map
+    //    -------------------------------------------------------------------------------
+    MapRange(PhysToVirt(0), 0, LEGACY_END >> 12, PG_KRN | PG_WRT | PG_DEV);
+
+    for (Addr_t e = (Addr_t)mmap->entries; e < mmapEnd; e += mmap->entrySize) {
+        MbootMmapEntry_t *entry = (MbootMmapEntry_t *)e;
+        int flags = PG_KRN | PG_WRT;
+
+        switch (entry->type) {
+        case MBOOT_MEM_AVAILABLE:
+        case MBOOT_MEM_ACPI:
+        case MBOOT_MEM_NVS:
+            break;
+
+        case MBOOT_MEM_RESERVED:
+            flags |= PG_DEV;
+            break;
+
+        default:
+            continue;
+        }
+
+        Addr_t start = entry->addr & ~(Addr_t)(PAGE_SIZE - 1);
+        Addr_t end = (entry->addr + entry->len + PAGE_SIZE - 1) & ~(Addr_t)(PAGE_SIZE - 1);
+
+        if (end > DIRECT_MAP_SIZE) end = DIRECT_MAP_SIZE;
+        if (start >= end) continue;
+
+        MapRange(PhysToVirt(start), start >> 12, (end - start) >> 12, flags);
+
+        if (!(flags & PG_DEV)) ram += (end - start);
+    }
+
+    DbgPrintf("The direct map covers %lu MB of RAM\n", ram >> 20);
+}
+
@@ -11,6 +11,27 @@
 *
 *   Implementation of the Physical Memory Manager (PMM).
 *
+*   The PMM is a binary buddy allocator.  For each order there is a bitmap of naturally aligned blocks of
+*   `1 << order` frames, covering every frame up to the highest available frame reported by the Multiboot memory
+*   map.  A set bit indicates the whole block is free at that order (and is therefore not present at any other
+*   order).  Allocation splits a larger block when needed and freeing coalesces with the buddy block, so both are
+*   O(log n) in the size of memory.  Each order remembers the word where it last found a free block and starts its
+*   search there.
+*
+*   The frames are partitioned into zones, each belonging to a NUMA node.  A zone is a window over the bitmaps with
+*   its own hints and free counts; no free block straddles a zone boundary and blocks never coalesce across one.
+*   Allocations prefer the zones of the requesting CPU's node, then fall back to the other nodes in SLIT distance
+*   order.
+*
+*   Single frames are served from a per-CPU magazine (\ref FrameMag_t) which is refilled from and drained to the
+*   buddy allocator in batches, so the common path takes no shared lock.
+*
+*   Idle CPUs keep a small pool of frames which are already zeroed, so that page tables and other memory which must
+*   start out clear can be had without zeroing on the critical path.
+*
+*   Optionally, single frames are page colored: the color of a frame is its number modulo the number of pages in
+*   one way of the outermost cache, and each CPU cycles through the colors as it allocates.
+*
 * ------------------------------------------------------------------------------------------------------------------
 *
 *   |     Date    | Tracker |  Version | Pgmr | Description
@@ -22,17 +43,1592 @@
 
 
 #include "arch.h"
+#include "cpu.h"
+#include "internals.h"
+#include "spinlock.h"
+#include "mboot.h"
+#include "mmu.h"
+#include "pmm.h"
+#include "frame.h"
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmMap
+*   @brief              The bitmap of free blocks for each order; a set bit is a free block
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static uint64_t *pmmMap[PMM_MAX_ORDER] = {0};
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmWords
+*   @brief              The number of 64-bit words in the bitmap for each order
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static uint64_t pmmWords[PMM_MAX_ORDER] = {0};
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmZeroPool
+*   @brief              A stack of frames which have already been zeroed
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Frame_t pmmZeroPool[PMM_ZERO_POOL_SIZE];
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmZeroCount
+*   @brief              The number of frames in \ref pmmZeroPool
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static volatile int pmmZeroCount = 0;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmZeroLock
+*   @brief              The lock protecting \ref pmmZeroPool
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Spinlock_t pmmZeroLock = {0};
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            PmmZone_t
+*   @brief              Formalization of the \ref PmmZone_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             PmmZone_t
+*   @brief              A range of frames belonging to a single NUMA node
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct PmmZone_t {
+    Frame_t start;                              //!< The first frame in the zone
+    Frame_t end;                                //!< The frame after the last frame in the zone
+    int node;                                   //!< The NUMA node to which this zone belongs
+    uint64_t frames;                            //!< The number of available frames in this zone
+    uint64_t hint[PMM_MAX_ORDER];               //!< The word index where the next search for each order begins
+    uint64_t blocks[PMM_MAX_ORDER];             //!< The number of free blocks of each order
+    uint64_t allocs;                            //!< The number of blocks taken from the zone
+    uint64_t frees;                             //!< The number of blocks returned to the zone
+} PmmZone_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            PmmAffinity_t
+*   @brief              Formalization of the \ref PmmAffinity_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             PmmAffinity_t
+*   @brief              A memory range reported by the platform as belonging to a NUMA node
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct PmmAffinity_t {
+    Frame_t start;                              //!< The first frame in the range
+    Frame_t end;                                //!< The frame after the last frame in the range
+    int node;                                   //!< The NUMA node
+} PmmAffinity_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmZones
+*   @brief              The zones, sorted by starting frame and covering every frame the PMM manages
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static PmmZone_t pmmZones[PMM_MAX_ZONES];
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmZoneCount
+*   @brief              The number of zones in use
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static int pmmZoneCount = 0;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmAffinity
+*   @brief              The memory affinity ranges reported by the platform, waiting for \ref PmmInitZones
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_DATA
+static PmmAffinity_t pmmAffinity[PMM_MAX_ZONES];
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmAffinityCount
+*   @brief              The number of memory affinity ranges reported
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_DATA
+static int pmmAffinityCount = 0;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmNodeCount
+*   @brief              The number of NUMA nodes which have memory
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static int pmmNodeCount = 0;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmDistance
+*   @brief              The relative distance between nodes as reported by the SLIT; 0 when not reported
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static uint8_t pmmDistance[PMM_MAX_NODES][PMM_MAX_NODES];
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmNodeOrder
+*   @brief              For each node, the nodes to try for an allocation, nearest first
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static int pmmNodeOrder[PMM_MAX_NODES][PMM_MAX_NODES];
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmFrameLimit
+*   @brief              One more than the highest frame managed by the PMM
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Frame_t pmmFrameLimit = 0;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmReady
+*   @brief              Has the PMM been initialized?  If not, frames come from `earlyFrame`
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static bool pmmReady = false;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmColors
+*   @brief              The number of page colors; a power of 2 no larger than `PMM_MAX_COLORS`
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_DATA
+static int pmmColors = 1;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmColoring
+*   @brief              Are single frames allocated by color?
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static bool pmmColoring = false;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmLock
+*   @brief              The lock protecting the PMM bitmaps
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Spinlock_t pmmLock = {0};
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            PmmStats_t
+*   @brief              Formalization of the \ref PmmStats_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             PmmStats_t
+*   @brief              The PMM counters kept by a single CPU
+*
+*   Only the owning CPU updates its counters, and only with interrupts disabled, so plain increments suffice.
+*   Each CPU's copy is in its own per-CPU block, so CPUs do not share lines.  The tag counts are net frames and
+*   may go negative on a CPU which frees frames another CPU allocated.
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct PmmStats_t {
+    uint64_t allocs[PMM_MAX_ORDER];             //!< The number of blocks allocated at each order
+    uint64_t frees[PMM_MAX_ORDER];              //!< The number of blocks freed at each order
+    uint64_t failures;                          //!< The number of allocations which found no memory
+    uint64_t magRefills;                        //!< The number of times the magazine was refilled
+    uint64_t magDrains;                         //!< The number of times the magazine was drained
+    uint64_t colorMisses;                       //!< Colored allocations which found no frame of the color
+    uint64_t zeroMisses;                        //!< Requests for a zeroed frame when the pool was empty
+    int64_t tagFrames[PMM_TAG_COUNT];           //!< The net number of frames allocated under each tag
+} PmmStats_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmStats
+*   @brief              This CPU's PMM counters
+*///-----------------------------------------------------------------------------------------------------------------
+PER_CPU
+static PmmStats_t pmmStats;
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmTagNames
+*   @brief              The names of the allocation-site tags, for \ref PmmDumpStats
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_RODATA
+static const char *const pmmTagNames[PMM_TAG_COUNT] = {
+    "none", "pmm", "frame-desc", "pgtable", "stack", "zero-pool", "test", "demand", "cpu",
+};
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmCountAlloc(int order, int tag)
+*   @brief              Count an allocation in this CPU's statistics; interrupts must be disabled
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void PmmCountAlloc(int order, int tag) {
+    PmmStats_t *st = PerCpuThis(pmmStats);
+
+    st->allocs[order] ++;
+    st->tagFrames[tag] += ((int64_t)1 << order);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmCountFree(int order, int tag)
+*   @brief              Count a free in this CPU's statistics; interrupts must be disabled
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void PmmCountFree(int order, int tag) {
+    PmmStats_t *st = PerCpuThis(pmmStats);
+
+    st->frees[order] ++;
+    st->tagFrames[tag < PMM_TAG_COUNT ? tag : PMM_TAG_NONE] -= ((int64_t)1 << order);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool PmmTestBlock(int order, uint64_t idx)
+*   @brief              Is the block `idx` of `order` free?
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+bool PmmTestBlock(int order, uint64_t idx) {
+    return (pmmMap[order][idx / 64] & ((uint64_t)1 << (idx % 64))) != 0;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmSetBlock(int order, uint64_t idx)
+*   @brief              Mark the block `idx` of `order` free
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void PmmSetBlock(int order, uint64_t idx) {
+    pmmMap[order][idx / 64] |= ((uint64_t)1 << (idx % 64));
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmClearBlock(int order, uint64_t idx)
+*   @brief              Mark the block `idx` of `order` as not free
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+void PmmClearBlock(int order, uint64_t idx) {
+    pmmMap[order][idx / 64] &= ~((uint64_t)1 << (idx % 64));
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmMarkRange(Frame_t start, Frame_t end, bool isFree)
+*   @brief              Mark a range of frames as free or used in the order 0 bitmap
+*
+*   This is only used while building the bitmaps.  Whole words are filled at a time where possible.
+*
+*   @param              start               The first frame to mark
+*   @param              end                 The frame after the last frame to mark
+*   @param              isFree              `true` to mark the frames free; `false` to mark them used
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmMarkRange(Frame_t start, Frame_t end, bool isFree)
+{
+    if (end > pmmFrameLimit) end = pmmFrameLimit;
+
+    while (start < end) {
+        if (start % 64 == 0 && end - start >= 64) {
+            pmmMap[0][start / 64] = (isFree ? ~(uint64_t)0 : 0);
+            start += 64;
+            continue;
+        }
+
+        if (isFree) PmmSetBlock(0, start);
+        else PmmClearBlock(0, start);
+
+        start ++;
+    }
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t PmmZoneBits(PmmZone_t *z, int order, uint64_t w)
+*   @brief              Get the free bits for `order` in word `w`, limited to the blocks inside zone `z`
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint64_t PmmZoneBits(PmmZone_t *z, int order, uint64_t w) {
+    uint64_t lo = z->start >> order;
+    uint64_t hi = ((z->end - 1) >> order) + 1;
+    uint64_t bits = pmmMap[order][w];
+
+    if (w == lo / 64) bits &= ~(uint64_t)0 << (lo % 64);
+    if (w == (hi - 1) / 64 && hi % 64) bits &= ((uint64_t)1 << (hi % 64)) - 1;
+
+    return bits;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 PmmZone_t *PmmFindZone(Frame_t f)
+*   @brief              Find the zone containing frame `f`
+*
+*   @param              f                   The frame to look up
+*
+*   @returns            The zone containing `f`; `nullptr` if the frame is not managed
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+PmmZone_t *PmmFindZone(Frame_t f)
+{
+    for (int z = 0; z < pmmZoneCount; z ++) {
+        if (f >= pmmZones[z].start && f < pmmZones[z].end) return &pmmZones[z];
+    }
+
+    return nullptr;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t PmmCountAvailable(Frame_t start, Frame_t end)
+*   @brief              Count the frames the Multiboot memory map reports as available within a range
+*
+*   @param              start               The first frame in the range
+*   @param              end                 The frame after the last frame in the range
+*
+*   @returns            The number of available frames
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+uint64_t PmmCountAvailable(Frame_t start, Frame_t end)
+{
+    MbootMmap_t *mmap = (MbootMmap_t *)MbootFindTag(MBOOT_TAG_MMAP, nullptr);
+    if (!mmap) return 0;
+
+    Addr_t mmapEnd = (Addr_t)mmap + mmap->tag.size;
+    uint64_t rv = 0;
+
+    for (Addr_t e = (Addr_t)mmap->entries; e < mmapEnd; e += mmap->entrySize) {
+        MbootMmapEntry_t *entry = (MbootMmapEntry_t *)e;
+        if (entry->type != MBOOT_MEM_AVAILABLE) continue;
+
+        Frame_t s = (entry->addr + PAGE_SIZE - 1) >> 12;
+        Frame_t t = (entry->addr + entry->len) >> 12;
+
+        if (s < start) s = start;
+        if (t > end) t = end;
+        if (s < t) rv += t - s;
+    }
+
+    return rv;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmZoneCount(PmmZone_t *z)
+*   @brief              Recount the free blocks of each order in a zone and reset its hints
+*
+*   @param              z                   The zone to count
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmZoneCount(PmmZone_t *z)
+{
+    for (int o = 0; o < PMM_MAX_ORDER; o ++) {
+        uint64_t first = (z->start >> o) / 64;
+        uint64_t last = ((z->end - 1) >> o) / 64;
+
+        z->hint[o] = first;
+        z->blocks[o] = 0;
+
+        for (uint64_t w = first; w <= last; w ++) {
+            uint64_t bits = PmmZoneBits(z, o, w);
+
+            while (bits) {
+                bits &= bits - 1;
+                z->blocks[o] ++;
+            }
+        }
+    }
+
+    z->frames = PmmCountAvailable(z->start, z->end);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmSplitAt(Frame_t f)
+*   @brief              Split any free block which straddles frame `f` so that `f` becomes a block boundary
+*
+*   @param              f                   The frame which will start a new zone
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmSplitAt(Frame_t f)
+{
+    for (int o = PMM_MAX_ORDER - 1; o > 0; o --) {
+        if ((f & (((Frame_t)1 << o) - 1)) == 0) continue;
+
+        uint64_t idx = f >> o;
+
+        if (PmmTestBlock(o, idx)) {
+            PmmClearBlock(o, idx);
+            PmmSetBlock(o - 1, idx * 2);
+            PmmSetBlock(o - 1, idx * 2 + 1);
+        }
+    }
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t PmmTakeBlock(PmmZone_t *z, int order)
+*   @brief              Find a free block of `order` in zone `z`, remove it from the bitmap and return its index
+*
+*   The caller must hold \ref pmmLock and must have checked that the zone has a free block of `order`.
+*
+*   @param              z                   The zone from which to take the block
+*   @param              order               The order of the block to find
+*
+*   @returns            The index of the block within `order`
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmTakeBlock(PmmZone_t *z, int order)
+{
+    uint64_t first = (z->start >> order) / 64;
+    uint64_t last = ((z->end - 1) >> order) / 64;
+    uint64_t words = last - first + 1;
+    uint64_t hint = z->hint[order];
+
+    if (hint < first || hint > last) hint = first;
+
+    for (uint64_t i = 0; i < words; i ++) {
+        uint64_t w = hint + i;
+        if (w > last) w -= words;
+
+        uint64_t bits = PmmZoneBits(z, order, w);
+
+        if (bits) {
+            uint64_t b = __builtin_ctzl(bits);
+
+            pmmMap[order][w] &= ~((uint64_t)1 << b);
+            z->hint[order] = w;
+            z->blocks[order] --;
+            return w * 64 + b;
+        }
+    }
+
+    KernelPanic("PMM free block counts are corrupt");
+}
 
 
 
 /********************************************************************************************************************
 *   See documentation in pmm.h
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
-Frame_t PmmAllocate(void)
+INIT_FUNC
+void PmmInit(void)
 {
     extern Frame_t earlyFrame;
+    extern uint8_t _mbStart[];
+    extern uint8_t _dataEnd[];
+
+    MbootInit();
+
+    MbootMmap_t *mmap = (MbootMmap_t *)MbootFindTag(MBOOT_TAG_MMAP, nullptr);
+    if (!mmap) KernelPanic("The boot loader did not provide a memory map");
+
+    Addr_t mmapEnd = (Addr_t)mmap + mmap->tag.size;
+
+
+    //
+    // -- Pass 1: find the highest available frame so we know how large the bitmaps need to be
+    //    -------------------------------------------------------------------------------------
+    for (Addr_t e = (Addr_t)mmap->entries; e < mmapEnd; e += mmap->entrySize) {
+        MbootMmapEntry_t *entry = (MbootMmapEntry_t *)e;
+        if (entry->type != MBOOT_MEM_AVAILABLE) continue;
+
+        Frame_t last = (entry->addr + entry->len) >> 12;
+        if (last > pmmFrameLimit) pmmFrameLimit = last;
+    }
+
+
+    //
+    // -- Lay the bitmaps out one after the other; each has room for the buddy of its last block
+    //    --------------------------------------------------------------------------------------
+    uint64_t totalWords = 0;
+
+    for (int o = 0; o < PMM_MAX_ORDER; o ++) {
+        pmmMap[o] = (uint64_t *)PMM_BITMAP_ADDR + totalWords;
+        pmmWords[o] = (pmmFrameLimit >> o) / 64 + 1;
+        totalWords += pmmWords[o];
+    }
+
+
+    //
+    // -- Build the bitmaps with frames from the early allocator; everything starts out used
+    //    ----------------------------------------------------------------------------------
+    Addr_t bitmapSize = (totalWords * sizeof(uint64_t) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    for (Addr_t a = 0; a < bitmapSize; a += PAGE_SIZE) {
+        MapPage(PMM_BITMAP_ADDR + a, PmmAllocate(PMM_TAG_PMM), PG_KRN | PG_WRT);
+    }
+
+    for (uint64_t w = 0; w < totalWords; w ++) pmmMap[0][w] = 0;
+
+
+    //
+    // -- Pass 2: free all the frames the memory map reports as available
+    //    ---------------------------------------------------------------
+    for (Addr_t e = (Addr_t)mmap->entries; e < mmapEnd; e += mmap->entrySize) {
+        MbootMmapEntry_t *entry = (MbootMmapEntry_t *)e;
+        if (entry->type != MBOOT_MEM_AVAILABLE) continue;
+
+        PmmMarkRange((entry->addr + PAGE_SIZE - 1) >> 12, (entry->addr + entry->len) >> 12, true);
+    }
+
+
+    //
+    // -- Now, take back everything we already know is in use
+    //    ---------------------------------------------------
+    Addr_t mbiStart, mbiEnd;
+    MbootGetRange(&mbiStart, &mbiEnd);
+
+    PmmMarkRange(0, 0x100, false);                                          // -- the first 1MB; BIOS & trampoline
+    PmmMarkRange((Addr_t)_mbStart >> 12, ((Addr_t)_dataEnd - KERNEL_BASE + PAGE_SIZE - 1) >> 12, false);
+    PmmMarkRange(mbiStart >> 12, (mbiEnd + PAGE_SIZE - 1) >> 12, false);
+
+    for (MbootModule_t *mod = (MbootModule_t *)MbootFindTag(MBOOT_TAG_MODULE, nullptr); mod;
+            mod = (MbootModule_t *)MbootFindTag(MBOOT_TAG_MODULE, &mod->tag)) {
+        PmmMarkRange(mod->modStart >> 12, (mod->modEnd + PAGE_SIZE - 1) >> 12, false);
+    }
+
+    // -- this must be last: it includes the stack, paging tables, and bitmap frames
+    PmmMarkRange(EARLY_FRAME_START, earlyFrame, false);
+
+
+    //
+    // -- Coalesce: every pair of free buddies at one order becomes a single free block at the next order
+    //    -----------------------------------------------------------------------------------------------
+    for (int o = 0; o < PMM_MAX_ORDER - 1; o ++) {
+        for (uint64_t w = 0; w < pmmWords[o]; w ++) {
+            uint64_t pairs = pmmMap[o][w] & (pmmMap[o][w] >> 1) & 0x5555555555555555;
+            pmmMap[o][w] &= ~(pairs | (pairs << 1));
+
+            while (pairs) {
+                uint64_t b = __builtin_ctzl(pairs);
+                pairs &= pairs - 1;
+                PmmSetBlock(o + 1, (w * 64 + b) / 2);
+            }
+        }
+    }
+
+
+    //
+    // -- Until the platform reports its NUMA topology, everything is a single zone on node 0
+    //    -----------------------------------------------------------------------------------
+    pmmZones[0].start = 0;
+    pmmZones[0].end = pmmFrameLimit;
+    pmmZones[0].node = 0;
+    PmmZoneCount(&pmmZones[0]);
+    pmmZones[0].hint[0] = EARLY_FRAME_START / 64;
+
+    pmmZoneCount = 1;
+    pmmNodeCount = 1;
+    pmmNodeOrder[0][0] = 0;
+
+    pmmReady = true;
+
+    DbgPrintf("PMM: %lu of %lu frames are free\n", PmmFreeCount(), pmmFrameLimit);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmZoneAllocate(PmmZone_t *z, int order)
+*   @brief              Allocate a block from a zone; the caller must hold \ref pmmLock
+*
+*   @param              z                   The zone from which to allocate
+*   @param              order               The order of the block to allocate
+*
+*   @returns            The first frame of the allocated block; 0 if the zone has none available
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmZoneAllocate(PmmZone_t *z, int order)
+{
+    int o = order;
+    while (o < PMM_MAX_ORDER && z->blocks[o] == 0) o ++;
+
+    if (o == PMM_MAX_ORDER) return 0;
+
+    uint64_t idx = PmmTakeBlock(z, o);
+    z->allocs ++;
+
+
+    //
+    // -- Split the block down to the requested order, freeing the upper half each time
+    //    -----------------------------------------------------------------------------
+    while (o > order) {
+        o --;
+        idx *= 2;
+
+        PmmSetBlock(o, idx + 1);
+        z->blocks[o] ++;
+    }
+
+    return idx << order;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmAllocateLocked(int order, int node)
+*   @brief              Allocate a block from the buddy allocator; the caller must hold \ref pmmLock
+*
+*   The zones of `node` are tried first, then the zones of the other nodes from nearest to farthest.
+*
+*   @param              order               The order of the block to allocate
+*   @param              node                The preferred NUMA node
+*
+*   @returns            The first frame of the allocated block; 0 if there is none available
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateLocked(int order, int node)
+{
+    if (node < 0 || node >= pmmNodeCount) node = 0;
+
+    for (int i = 0; i < pmmNodeCount; i ++) {
+        int n = pmmNodeOrder[node][i];
+
+        for (int z = 0; z < pmmZoneCount; z ++) {
+            if (pmmZones[z].node != n) continue;
+
+            Frame_t rv = PmmZoneAllocate(&pmmZones[z], order);
+            if (rv) return rv;
+        }
+    }
+
+    return 0;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmZoneTakeColor(PmmZone_t *z, int color)
+*   @brief              Allocate a single frame of a given color from a zone; the caller must hold \ref pmmLock
+*
+*   The smallest free block which holds a frame of `color` is taken and split down to that frame, freeing the
+*   halves which do not hold it.  A block of order `o` starting at frame `s` holds the colors `s` through
+*   `s + (1 << o) - 1` (modulo the number of colors), so at each order only every `(colors >> o)`th block can
+*   qualify; those are picked out of each bitmap word with a mask.
+*
+*   @param              z                   The zone from which to allocate
+*   @param              color               The color of the frame to allocate
+*
+*   @returns            The frame allocated; 0 if the zone has no free frame of that color
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmZoneTakeColor(PmmZone_t *z, int color)
+{
+    for (int o = 0; o < PMM_MAX_ORDER; o ++) {
+        if (z->blocks[o] == 0) continue;
+
+        uint64_t idx;
+        uint64_t period = pmmColors >> o;
+
+        if (period <= 1) {
+            // -- every block at this order holds every color
+            idx = PmmTakeBlock(z, o);
+        } else {
+            uint64_t mask = 0;
+            for (uint64_t b = (color >> o) & (period - 1); b < 64; b += period) mask |= ((uint64_t)1 << b);
+
+            uint64_t first = (z->start >> o) / 64;
+            uint64_t last = ((z->end - 1) >> o) / 64;
+            uint64_t w;
+            uint64_t bits = 0;
+
+            for (w = first; w <= last; w ++) {
+                bits = PmmZoneBits(z, o, w) & mask;
+                if (bits) break;
+            }
+
+            if (!bits) continue;
+
+            idx = w * 64 + __builtin_ctzl(bits);
+            PmmClearBlock(o, idx);
+            z->blocks[o] --;
+        }
+
+
+        z->allocs ++;
+
+
+        //
+        // -- Split down to the frame with the color, freeing the other half each time
+        //    ------------------------------------------------------------------------
+        Frame_t start = idx << o;
+        Frame_t rv = start + ((color - start) & (pmmColors - 1));
+
+        while (o > 0) {
+            o --;
+            uint64_t half = rv >> o;
+
+            PmmSetBlock(o, half ^ 1);
+            z->blocks[o] ++;
+        }
+
+        return rv;
+    }
+
+    return 0;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t PmmAllocateColorLocked(int color, int node)
+*   @brief              Allocate a single frame of a given color; the caller must hold \ref pmmLock
+*
+*   The zones are tried in the same order as \ref PmmAllocateLocked.
+*
+*   @param              color               The color of the frame to allocate
+*   @param              node                The preferred NUMA node
+*
+*   @returns            The frame allocated; 0 if there is no free frame of that color
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateColorLocked(int color, int node)
+{
+    if (node < 0 || node >= pmmNodeCount) node = 0;
+
+    for (int i = 0; i < pmmNodeCount; i ++) {
+        int n = pmmNodeOrder[node][i];
+
+        for (int z = 0; z < pmmZoneCount; z ++) {
+            if (pmmZones[z].node != n) continue;
+
+            Frame_t rv = PmmZoneTakeColor(&pmmZones[z], color);
+            if (rv) return rv;
+        }
+    }
+
+    return 0;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmFreeLocked(Frame_t f, int order)
+*   @brief              Return a block to the buddy allocator; the caller must hold \ref pmmLock
+*
+*   @param              f                   The first frame of the block
+*   @param              order               The order of the block
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmFreeLocked(Frame_t f, int order)
+{
+    PmmZone_t *z = PmmFindZone(f);
+    uint64_t idx = f >> order;
+
+    if (!z) return;
+
+    if (PmmTestBlock(order, idx)) {
+        DbgPrintf("PMM: frame %lu is already free\n", f);
+        return;
+    }
+
+
+    //
+    // -- Coalesce with the buddy while the buddy is free and the merged block stays inside the zone
+    //    ------------------------------------------------------------------------------------------
+    while (order < PMM_MAX_ORDER - 1) {
+        Frame_t merged = (idx / 2) << (order + 1);
+
+        if (merged < z->start || merged + ((Frame_t)1 << (order + 1)) > z->end) break;
+        if (!PmmTestBlock(order, idx ^ 1)) break;
+
+        PmmClearBlock(order, idx ^ 1);
+        z->blocks[order] --;
+
+        idx /= 2;
+        order ++;
+    }
+
+    PmmSetBlock(order, idx);
+    z->blocks[order] ++;
+    z->frees ++;
+    if (idx / 64 < z->hint[order]) z->hint[order] = idx / 64;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateOrder(int order, PmmTag_t tag)
+{
+    extern Frame_t earlyFrame;
+
+    if (order < 0 || order >= PMM_MAX_ORDER) return 0;
+    if (tag < 0 || tag >= PMM_TAG_COUNT) tag = PMM_TAG_NONE;
+
+    if (!pmmReady) {
+        // -- the frames skipped to align the block are reclaimed as used by PmmInit(); a small leak
+        Frame_t size = (Frame_t)1 << order;
+        earlyFrame = (earlyFrame + size - 1) & ~(size - 1);
+        Frame_t rv = earlyFrame;
+        earlyFrame += size;
+        return rv;
+    }
+
+    Addr_t flags = DisableInterrupts();
+    int node = PerCpuRead(cpuLocal.node);
+
+    SpinLock(&pmmLock);
+    Frame_t rv = PmmAllocateLocked(order, node);
+    SpinUnlock(&pmmLock);
+
+    if (rv) PmmCountAlloc(order, tag);
+    else PerCpuWrite(pmmStats.failures, PerCpuRead(pmmStats.failures) + 1);
+
+    RestoreInterrupts(flags);
+
+    if (rv) FrameOnAlloc(rv, order, tag);
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateNode(int node, PmmTag_t tag)
+{
+    if (!pmmReady) return PmmAllocateOrder(0, tag);
+    if (tag < 0 || tag >= PMM_TAG_COUNT) tag = PMM_TAG_NONE;
+
+    Addr_t flags = DisableInterrupts();
+
+    SpinLock(&pmmLock);
+    Frame_t rv = PmmAllocateLocked(0, node);
+    SpinUnlock(&pmmLock);
+
+    if (rv) PmmCountAlloc(0, tag);
+    else PerCpuWrite(pmmStats.failures, PerCpuRead(pmmStats.failures) + 1);
+
+    RestoreInterrupts(flags);
+
+    if (rv) FrameOnAlloc(rv, 0, tag);
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocate(PmmTag_t tag)
+{
+    if (!pmmReady) return PmmAllocateOrder(0, tag);
+    if (tag < 0 || tag >= PMM_TAG_COUNT) tag = PMM_TAG_NONE;
+
+    Addr_t flags = DisableInterrupts();
+    FrameMag_t *mag = &ThisCpu()->frameMag;
+    Frame_t rv = 0;
+
+
+    //
+    // -- With coloring on, look for the next color in the magazine and then in the buddy allocator
+    //    -----------------------------------------------------------------------------------------
+    if (pmmColoring) {
+        int color = PerCpuRead(cpuLocal.nextColor);
+        PerCpuWrite(cpuLocal.nextColor, (color + 1) & (pmmColors - 1));
+
+        for (int i = mag->count - 1; i >= 0; i --) {
+            if ((int)(mag->frames[i] & (pmmColors - 1)) != color) continue;
+
+            rv = mag->frames[i];
+            mag->count --;
+            for (int j = i; j < mag->count; j ++) mag->frames[j] = mag->frames[j + 1];
+            break;
+        }
+
+        if (!rv) {
+            SpinLock(&pmmLock);
+            rv = PmmAllocateColorLocked(color, PerCpuRead(cpuLocal.node));
+            SpinUnlock(&pmmLock);
+        }
+
+        if (rv) {
+            PmmCountAlloc(0, tag);
+            RestoreInterrupts(flags);
+            FrameOnAlloc(rv, 0, tag);
+            return rv;
+        }
+
+        PerCpuWrite(pmmStats.colorMisses, PerCpuRead(pmmStats.colorMisses) + 1);
+    }
+
+
+    //
+    // -- An empty magazine is refilled with a batch of frames under a single lock
+    //    ------------------------------------------------------------------------
+    if (mag->count == 0) {
+        PerCpuWrite(pmmStats.magRefills, PerCpuRead(pmmStats.magRefills) + 1);
+        SpinLock(&pmmLock);
+
+        while (mag->count < FRAME_MAG_BATCH) {
+            Frame_t f = PmmAllocateLocked(0, PerCpuRead(cpuLocal.node));
+            if (!f) break;
+
+            mag->frames[mag->count ++] = f;
+        }
+
+        SpinUnlock(&pmmLock);
+    }
+
+    if (mag->count) rv = mag->frames[-- mag->count];
+
+    if (rv) PmmCountAlloc(0, tag);
+    else PerCpuWrite(pmmStats.failures, PerCpuRead(pmmStats.failures) + 1);
+
+    RestoreInterrupts(flags);
+
+    if (rv) FrameOnAlloc(rv, 0, tag);
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t PmmAllocateZeroed(PmmTag_t tag)
+{
+    if (tag < 0 || tag >= PMM_TAG_COUNT) tag = PMM_TAG_NONE;
+
+    Frame_t rv = 0;
+    Addr_t flags = DisableInterrupts();
+
+    if (pmmZeroCount) {
+        SpinLock(&pmmZeroLock);
+        if (pmmZeroCount) rv = pmmZeroPool[-- pmmZeroCount];
+        SpinUnlock(&pmmZeroLock);
+    }
+
+
+    //
+    // -- The frame was counted against the pool when it was zeroed; move it to the new tag
+    //    ---------------------------------------------------------------------------------
+    if (rv) {
+        PmmStats_t *st = PerCpuThis(pmmStats);
+
+        st->tagFrames[PMM_TAG_ZERO_POOL] --;
+        st->tagFrames[tag] ++;
+    } else {
+        PerCpuWrite(pmmStats.zeroMisses, PerCpuRead(pmmStats.zeroMisses) + 1);
+    }
+
+    RestoreInterrupts(flags);
+
+    if (rv) FrameOnAlloc(rv, 0, tag);
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool PmmZeroIdle(void)
+{
+    if (!pmmReady || pmmZeroCount >= PMM_ZERO_POOL_SIZE) return false;
+
+    Frame_t f = PmmAllocate(PMM_TAG_ZERO_POOL);
+    if (!f) return false;
+
+    // -- the direct map reaches the frame, so no paging tables are touched
+    uint64_t *page = (uint64_t *)PhysToVirt((Addr_t)f << 12);
+
+    for (int i = 0; i < 512; i ++) MOVNTI(&page[i], 0);
+    SFENCE();
+
+    Addr_t flags = DisableInterrupts();
+    SpinLock(&pmmZeroLock);
+
+    bool rv = (pmmZeroCount < PMM_ZERO_POOL_SIZE);
+    if (rv) pmmZeroPool[pmmZeroCount ++] = f;
+
+    SpinUnlock(&pmmZeroLock);
+    RestoreInterrupts(flags);
+
+    // -- another CPU filled the pool while we were working
+    if (!rv) PmmFree(f);
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmFreeOrder(Frame_t f, int order)
+{
+    if (!pmmReady || f == 0 || f >= pmmFrameLimit) return;
+    if (order < 0 || order >= PMM_MAX_ORDER) return;
+
+    if (f & (((Frame_t)1 << order) - 1)) {
+        DbgPrintf("PMM: frame %lu is not aligned for order %d\n", f, order);
+        return;
+    }
+
+    int tag = FrameOnFree(f, order);
+
+    Addr_t flags = DisableInterrupts();
+
+    SpinLock(&pmmLock);
+    PmmFreeLocked(f, order);
+    SpinUnlock(&pmmLock);
+
+    PmmCountFree(order, tag);
+
+    RestoreInterrupts(flags);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmReleaseRange(Frame_t start, Frame_t end)
+{
+    for (Frame_t f = start; f < end; f ++) {
+        if (FrameIsAvailable(f)) PmmFree(f);
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmFree(Frame_t f)
+{
+    if (!pmmReady || f == 0 || f >= pmmFrameLimit) return;
+
+    int tag = FrameOnFree(f, 0);
+
+    Addr_t flags = DisableInterrupts();
+    FrameMag_t *mag = &ThisCpu()->frameMag;
+
+    PmmCountFree(0, tag);
+
+
+    //
+    // -- A full magazine drains a batch of its oldest frames back to the buddy allocator under a single lock
+    //    ---------------------------------------------------------------------------------------------------
+    if (mag->count == FRAME_MAG_SIZE) {
+        PerCpuWrite(pmmStats.magDrains, PerCpuRead(pmmStats.magDrains) + 1);
+        SpinLock(&pmmLock);
+
+        for (int i = 0; i < FRAME_MAG_BATCH; i ++) PmmFreeLocked(mag->frames[i], 0);
+
+        SpinUnlock(&pmmLock);
+
+        for (int i = FRAME_MAG_BATCH; i < FRAME_MAG_SIZE; i ++) mag->frames[i - FRAME_MAG_BATCH] = mag->frames[i];
+        mag->count -= FRAME_MAG_BATCH;
+    }
+
+    mag->frames[mag->count ++] = f;
+
+    RestoreInterrupts(flags);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmFreeCount(void)
+{
+    uint64_t rv = 0;
+
+    for (int n = 0; n < pmmNodeCount; n ++) rv += PmmNodeFreeCount(n);
+    for (int i = 0; i < MAX_CPU; i ++) if (cpus[i]) rv += cpus[i]->frameMag.count;
+    rv += pmmZeroCount;
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmFreeCountOrder(int order)
+{
+    if (order < 0 || order >= PMM_MAX_ORDER) return 0;
+
+    uint64_t rv = 0;
+
+    for (int z = 0; z < pmmZoneCount; z ++) rv += pmmZones[z].blocks[order];
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmNodeFreeCount(int node)
+{
+    uint64_t rv = 0;
+
+    for (int z = 0; z < pmmZoneCount; z ++) {
+        if (pmmZones[z].node != node) continue;
+
+        for (int o = 0; o < PMM_MAX_ORDER; o ++) rv += (pmmZones[z].blocks[o] << o);
+    }
+
+    return rv;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+uint64_t PmmNodeUsedCount(int node)
+{
+    uint64_t frames = 0;
+
+    for (int z = 0; z < pmmZoneCount; z ++) {
+        if (pmmZones[z].node == node) frames += pmmZones[z].frames;
+    }
+
+    return frames - PmmNodeFreeCount(node);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmDumpStats(void)
+{
+    uint64_t magFrames = 0;
+
+    for (int i = 0; i < MAX_CPU; i ++) if (cpus[i]) magFrames += cpus[i]->frameMag.count;
+
+    DbgPrintf("PMM: %lu of %lu frames free (%lu in magazines; %d pre-zeroed)\n", PmmFreeCount(), pmmFrameLimit,
+            magFrames, pmmZeroCount);
+
+
+    //
+    // -- Each zone: its free memory and how much of that is in blocks too small for a 2M (order 9) request
+    //    -------------------------------------------------------------------------------------------------
+    for (int z = 0; z < pmmZoneCount; z ++) {
+        PmmZone_t *zone = &pmmZones[z];
+        uint64_t free = 0;
+        uint64_t small = 0;
+        int largest = -1;
+
+        for (int o = 0; o < PMM_MAX_ORDER; o ++) {
+            free += (zone->blocks[o] << o);
+            if (o < 9) small += (zone->blocks[o] << o);
+            if (zone->blocks[o]) largest = o;
+        }
+
+        DbgPrintf("PMM: zone %d (node %d): frames %lu to %lu; %lu free\n", z, zone->node, zone->start, zone->end,
+                free);
+        DbgPrintf("PMM:   %lu blocks taken; %lu returned; largest free order %d; %lu%% of free frames below 2M\n",
+                zone->allocs, zone->frees, largest, free ? small * 100 / free : 0);
+    }
+
+
+    //
+    // -- Each order, summed over the CPUs
+    //    --------------------------------
+    for (int o = 0; o < PMM_MAX_ORDER; o ++) {
+        uint64_t allocs = 0;
+        uint64_t frees = 0;
+
+        for (int i = 0; i < cpuCount; i ++) {
+            if (!cpus[i]) continue;
+
+            allocs += PerCpuPtr(i, pmmStats)->allocs[o];
+            frees += PerCpuPtr(i, pmmStats)->frees[o];
+        }
+
+        uint64_t blocks = PmmFreeCountOrder(o);
+        if (allocs == 0 && frees == 0 && blocks == 0) continue;
+
+        DbgPrintf("PMM: order %d: %lu free blocks; %lu allocated; %lu freed\n", o, blocks, allocs, frees);
+    }
+
+
+    //
+    // -- The event counters and the frames held under each tag
+    //    -----------------------------------------------------
+    uint64_t failures = 0, refills = 0, drains = 0, colorMisses = 0, zeroMisses = 0;
+
+    for (int i = 0; i < cpuCount; i ++) {
+        if (!cpus[i]) continue;
+
+        PmmStats_t *st = PerCpuPtr(i, pmmStats);
+
+        failures += st->failures;
+        refills += st->magRefills;
+        drains += st->magDrains;
+        colorMisses += st->colorMisses;
+        zeroMisses += st->zeroMisses;
+    }
+
+    DbgPrintf("PMM: %lu failed; magazine %lu refills, %lu drains; %lu color misses; %lu zero-pool misses\n",
+            failures, refills, drains, colorMisses, zeroMisses);
+
+    for (int t = 0; t < PMM_TAG_COUNT; t ++) {
+        int64_t frames = 0;
+
+        for (int i = 0; i < cpuCount; i ++) {
+            if (cpus[i]) frames += PerCpuPtr(i, pmmStats)->tagFrames[t];
+        }
+
+        DbgPrintf("PMM: tag %s: %ld frames\n", pmmTagNames[t], frames);
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmAddMemoryAffinity(Frame_t start, Frame_t end, int node)
+{
+    if (start >= end) return;
+
+    if (node < 0 || node >= PMM_MAX_NODES) {
+        DbgPrintf("PMM: NUMA node %d is not supported; treating it as node 0\n", node);
+        node = 0;
+    }
+
+    if (pmmAffinityCount == PMM_MAX_ZONES) {
+        DbgPrintf("PMM: too many memory affinity ranges; ignoring the range at frame %lu\n", start);
+        return;
+    }
+
+    pmmAffinity[pmmAffinityCount].start = start;
+    pmmAffinity[pmmAffinityCount].end = end;
+    pmmAffinity[pmmAffinityCount].node = node;
+    pmmAffinityCount ++;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmSetNodeDistance(int from, int to, int distance)
+{
+    if (from < 0 || from >= PMM_MAX_NODES || to < 0 || to >= PMM_MAX_NODES) return;
+
+    pmmDistance[from][to] = distance;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmInitZones(void)
+{
+    if (pmmAffinityCount == 0) return;
+
+
+    //
+    // -- Sort the affinity ranges by starting frame
+    //    ------------------------------------------
+    for (int i = 1; i < pmmAffinityCount; i ++) {
+        PmmAffinity_t a = pmmAffinity[i];
+        int j = i - 1;
+
+        while (j >= 0 && pmmAffinity[j].start > a.start) {
+            pmmAffinity[j + 1] = pmmAffinity[j];
+            j --;
+        }
+
+        pmmAffinity[j + 1] = a;
+    }
+
+    SpinLock(&pmmLock);
+
+
+    //
+    // -- Build zones which cover all frames: a hole belongs to the zone before it and adjacent ranges on the
+    //    same node are merged
+    //    ---------------------------------------------------------------------------------------------------
+    int n = 0;
+    pmmNodeCount = 1;
+
+    for (int i = 0; i < pmmAffinityCount; i ++) {
+        Frame_t start = (n == 0 ? 0 : pmmAffinity[i].start);
+
+        if (start >= pmmFrameLimit) break;
+        if (n > 0 && pmmZones[n - 1].node == pmmAffinity[i].node) continue;
+
+        pmmZones[n].start = start;
+        pmmZones[n].node = pmmAffinity[i].node;
+        if (pmmAffinity[i].node >= pmmNodeCount) pmmNodeCount = pmmAffinity[i].node + 1;
+        n ++;
+    }
+
+    for (int z = 0; z < n; z ++) {
+        pmmZones[z].end = (z + 1 < n ? pmmZones[z + 1].start : pmmFrameLimit);
+        if (z > 0) PmmSplitAt(pmmZones[z].start);
+    }
+
+    pmmZoneCount = n;
+
+    for (int z = 0; z < n; z ++) PmmZoneCount(&pmmZones[z]);
+
+
+    //
+    // -- Order the fallback nodes for each node by distance; without a SLIT, local is 10 and remote is 20
+    //    ------------------------------------------------------------------------------------------------
+    for (int from = 0; from < pmmNodeCount; from ++) {
+        for (int to = 0; to < pmmNodeCount; to ++) {
+            if (pmmDistance[from][to] == 0) pmmDistance[from][to] = (from == to ? 10 : 20);
+            pmmNodeOrder[from][to] = to;
+        }
+
+        for (int i = 1; i < pmmNodeCount; i ++) {
+            int node = pmmNodeOrder[from][i];
+            int j = i - 1;
+
+            while (j >= 0 && pmmDistance[from][pmmNodeOrder[from][j]] > pmmDistance[from][node]) {
+                pmmNodeOrder[from][j + 1] = pmmNodeOrder[from][j];
+                j --;
+            }
+
+            pmmNodeOrder[from][j + 1] = node;
+        }
+    }
+
+    SpinUnlock(&pmmLock);
+
+    for (int z = 0; z < n; z ++) FrameSetNode(pmmZones[z].start, pmmZones[z].end, pmmZones[z].node);
+
+    for (int node = 0; node < pmmNodeCount; node ++) {
+        DbgPrintf("PMM: node %d: %lu frames free; %lu frames used\n", node,
+                PmmNodeFreeCount(node), PmmNodeUsedCount(node));
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmInitColors(void)
+{
+    int colors = ArchCacheColors();
+
+    pmmColors = (colors > PMM_MAX_COLORS ? PMM_MAX_COLORS : colors);
+
+    DbgPrintf("PMM: the cache has %d page colors; using %d\n", colors, pmmColors);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void PmmSetColoring(bool on)
+{
+    pmmColoring = (on && pmmColors > 1);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+int PmmColorCount(void)
+{
+    return pmmColors;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @def                PMM_BENCH_FRAMES
+*   @brief              The number of frames measured by each pass of \ref PmmColorBenchmark
+*///-----------------------------------------------------------------------------------------------------------------
+#define PMM_BENCH_FRAMES        (PMM_MAX_COLORS * 2)
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmBenchHeld
+*   @brief              The frames held by \ref PmmColorBenchmark to fragment memory
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_DATA
+static Frame_t pmmBenchHeld[PMM_BENCH_FRAMES * 4];
+
+
+
+/****************************************************************************************************************//**
+*   @var                pmmBenchFrames
+*   @brief              The frames measured by one pass of \ref PmmColorBenchmark
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_DATA
+static Frame_t pmmBenchFrames[PMM_BENCH_FRAMES];
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void PmmColorBenchmarkPass(bool coloring, int count)
+*   @brief              Allocate, measure, and free one set of frames for \ref PmmColorBenchmark
+*
+*   @param              coloring            Whether page coloring is on for this pass
+*   @param              count               The number of frames to allocate
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmColorBenchmarkPass(bool coloring, int count)
+{
+    int load[PMM_MAX_COLORS];
+    int worst = 0;
+
+    for (int c = 0; c < PMM_MAX_COLORS; c ++) load[c] = 0;
+
+    PmmSetColoring(coloring);
+    PerCpuWrite(cpuLocal.nextColor, 0);
+
+    for (int i = 0; i < count; i ++) {
+        pmmBenchFrames[i] = PmmAllocate(PMM_TAG_TEST);
+        MapPage(PMM_BENCH_ADDR + i * PAGE_SIZE, pmmBenchFrames[i], PG_KRN | PG_WRT);
+
+        int c = pmmBenchFrames[i] & (pmmColors - 1);
+        if (++ load[c] > worst) worst = load[c];
+    }
+
+    PmmSetColoring(false);
+
+
+    //
+    // -- Read the first line of every frame over and over; frames with the same color compete for the same sets
+    //    -----------------------------------------------------------------------------------------------------
+    volatile uint64_t sink = 0;
+
+    for (int i = 0; i < count; i ++) sink += *(volatile uint64_t *)(PMM_BENCH_ADDR + i * PAGE_SIZE);
+
+    uint64_t start = RDTSC();
+
+    for (int r = 0; r < 64; r ++) {
+        for (int i = 0; i < count; i ++) sink += *(volatile uint64_t *)(PMM_BENCH_ADDR + i * PAGE_SIZE);
+    }
+
+    uint64_t cycles = RDTSC() - start;
+
+    UnmapRange(PMM_BENCH_ADDR, count);
+    for (int i = 0; i < count; i ++) PmmFree(pmmBenchFrames[i]);
+
+    DbgPrintf("PMM: coloring %s: %d frames; worst color holds %d; %lu cycles\n", coloring ? "on " : "off",
+            count, worst, cycles);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in pmm.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void PmmColorBenchmark(void)
+{
+    if (pmmColors < 2) {
+        DbgPrintf("PMM: page coloring benchmark skipped; the cache has a single color\n");
+        return;
+    }
+
+    int held = 0;
+    int count = pmmColors * 2;
+
+
+    //
+    // -- Fragment memory: take a run of frames and then give back every 4th one
+    //    ----------------------------------------------------------------------
+    for (int i = 0; i < count * 4; i ++) {
+        Frame_t f = PmmAllocate(PMM_TAG_TEST);
+        if (!f) break;
+
+        pmmBenchHeld[held ++] = f;
+    }
+
+    int kept = 0;
+
+    for (int i = 0; i < held; i ++) {
+        if ((i & 3) == 0) PmmFree(pmmBenchHeld[i]);
+        else pmmBenchHeld[kept ++] = pmmBenchHeld[i];
+    }
+
+    held = kept;
+
+    PmmColorBenchmarkPass(false, count);
+    PmmColorBenchmarkPass(true, count);
 
-    return earlyFrame ++;
+    for (int i = 0; i < held; i ++) PmmFree(pmmBenchHeld[i]);
 }
 
@@ -0,0 +1,257 @@
+/****************************************************************************************************************//**
+*   @file               tlb.cc
+*   @brief              TLB shootdown across CPUs
+*   @author             Adam Clark (hobbyos@eryjus.com)
+*   @date               2026-Oct-17
+*   @since              v0.0.3
+*
+*   @copyright          Copyright (c)  2022 -- Adam Clark\n
+*                       Licensed under "THE BEER-WARE LICENSE"\n
+*                       See \ref LICENSE.md for details.
+*
+*   One shootdown is in flight at a time.  The sender publishes its batch, marks each target CPU pending, sends
+*   each one an IPI and waits for the acknowledgements.  A CPU which is itself waiting to send services any request
+*   pending for it while it waits, so two CPUs shooting down at the same time cannot deadlock with interrupts
+*   disabled.
+*
+* ------------------------------------------------------------------------------------------------------------------
+*
+*   |     Date    | Tracker |  Version | Pgmr | Description
+*   |:-----------:|:-------:|:--------:|:----:|:--------------------------------------------------------------------
+*   | 2026-Oct-17 | Initial |  v0.0.3  | ADCL | Initial version
+*
+*///=================================================================================================================
+
+
+
+#include "arch.h"
+#include "cpu.h"
+#include "doorbell.h"
+#include "spinlock.h"
+#include "tlb.h"
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            TlbCpu_t
+*   @brief              Formalization of the \ref TlbCpu_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             TlbCpu_t
+*   @brief              The shootdown state for a single CPU, on its own cache line since other CPUs write to it
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct TlbCpu_t {
+    volatile bool online;                       //!< The CPU can receive shootdown IPIs
+    volatile bool pending;                      //!< A request is waiting for this CPU
+} __attribute__((aligned(64))) TlbCpu_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                tlbCpu
+*   @brief              This CPU's shootdown state, which the CPU sending a shootdown reaches with \ref PerCpuPtr
+*///-----------------------------------------------------------------------------------------------------------------
+PER_CPU
+static TlbCpu_t tlbCpu;
+
+
+
+/****************************************************************************************************************//**
+*   @var                tlbLock
+*   @brief              Held by the CPU whose request is in flight
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Spinlock_t tlbLock;
+
+
+
+/****************************************************************************************************************//**
+*   @var                tlbRequest
+*   @brief              The batch in flight; it lives on the sender's stack until all the acknowledgements are in
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static TlbBatch_t *volatile tlbRequest;
+
+
+
+/****************************************************************************************************************//**
+*   @var                tlbAcks
+*   @brief              The number of target CPUs which have not yet serviced the request in flight
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static volatile int tlbAcks;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void TlbInvalidateLocal(TlbBatch_t *b)
+*   @brief              Apply a batch to this CPU's TLB
+*
+*   @param              b                   The batch
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbInvalidateLocal(TlbBatch_t *b)
+{
+    if (b->full) {
+        FlushTlbAll();
+        return;
+    }
+
+    bool sameSpace = (b->space == nullptr || b->space == AddrSpaceCurrent());
+
+
+    //
+    // -- INVLPG only reaches the running PCID, so the translations of another address space are dropped with its
+    //    PCID; kernel translations are global and are reached from any PCID
+    //    -------------------------------------------------------------------------------------------------------
+    if (!sameSpace) AddrSpaceDropLocal(b->space);
+
+    for (int i = 0; i < b->count; i ++) {
+        if (sameSpace || b->addr[i] >= USER_SPACE_END) INVLPG(b->addr[i]);
+    }
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool TlbIsTarget(TlbBatch_t *b, int cpu)
+*   @brief              Must a CPU apply a batch?
+*
+*   Kernel batches go to every online CPU; a batch for the user half only goes to the CPUs which may hold that
+*   address space's translations.
+*
+*   @param              b                   The batch
+*   @param              cpu                 The CPU number
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+bool TlbIsTarget(TlbBatch_t *b, int cpu) {
+    if (!cpus[cpu] || !PerCpuPtr(cpu, tlbCpu)->online) return false;
+
+    return b->space == nullptr || AddrSpaceOnCpu(b->space, cpu);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in tlb.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbService(void)
+{
+    if (!PerCpuRead(tlbCpu.pending)) return;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    PerCpuWrite(tlbCpu.pending, false);
+    TlbInvalidateLocal(tlbRequest);
+    __atomic_sub_fetch(&tlbAcks, 1, __ATOMIC_RELEASE);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in tlb.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbFlush(TlbBatch_t *b)
+{
+    if (b->count == 0 && !b->full) return;
+
+    Addr_t flags = DisableInterrupts();
+    int self = ThisCpuNum();
+    int targets = 0;
+
+    TlbInvalidateLocal(b);
+
+
+    //
+    // -- The fence orders the paging table changes before the mask is read; it pairs with the one a CPU takes
+    //    when it joins an address space (see AddrSpaceSwitch())
+    //    ----------------------------------------------------------------------------------------------------
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (int i = 0; i < cpuCount; i ++) {
+        if (i != self && TlbIsTarget(b, i)) targets ++;
+    }
+
+    if (targets) {
+        while (!SpinTryLock(&tlbLock)) {
+            TlbService();
+            PAUSE();
+        }
+
+        tlbRequest = b;
+        tlbAcks = 0;
+
+        for (int i = 0; i < cpuCount; i ++) {
+            if (i == self || !TlbIsTarget(b, i)) continue;
+
+            __atomic_add_fetch(&tlbAcks, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&PerCpuPtr(i, tlbCpu)->pending, true, __ATOMIC_RELEASE);
+            LapicSendIpi(i, IPI_TLB_SHOOTDOWN);
+        }
+
+        DoorbellWaitUntil(&tlbAcks, 0);
+
+        tlbRequest = nullptr;
+        SpinUnlock(&tlbLock);
+    }
+
+    RestoreInterrupts(flags);
+
+    b->count = 0;
+    b->full = false;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in tlb.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbFlushLocal(TlbBatch_t *b)
+{
+    TlbInvalidateLocal(b);
+
+    b->count = 0;
+    b->full = false;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in tlb.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbFlushPage(Addr_t a)
+{
+    TlbBatch_t b;
+
+    TlbBatchInit(&b, nullptr);
+    TlbQueue(&b, a);
+    TlbFlush(&b);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in tlb.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbCpuOnline(void)
+{
+    PerCpuWrite(tlbCpu.online, true);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    FlushTlbAll();
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in tlb.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void TlbShootdownHandler(void)
+{
+    TlbService();
+}
+
@@ -22,10 +22,14 @@
 
 
 #include "arch.h"
+#include "addr-space.h"
 #include "cpu.h"
+#include "doorbell.h"
+#include "kva.h"
 #include "mmu.h"
 #include "pmm.h"
 #include "internals.h"
+#include "tlb.h"
 
 
 
@@ -62,14 +66,82 @@
 
 
 
-/********************************************************************************************************************
-*   See `arch.h` for documentation
+/****************************************************************************************************************//**
+*   @def                PF_STACK_SIZE
+*   @brief              The size of the stack each CPU handles page faults on
+*///-----------------------------------------------------------------------------------------------------------------
+#define PF_STACK_SIZE       (2 * PAGE_SIZE)
+
+
+
+/****************************************************************************************************************//**
+*   @var                bootPfStack
+*   @brief              The boot processor's page fault stack, reached through IST1
+*
+*   A page fault from a stack which has run into its guard page cannot push its frame onto that stack, so page
+*   faults always switch to a stack which is known to be mapped.  The APs' page fault stacks are allocated by \ref MoveTrampoline.
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static uint8_t bootPfStack[PF_STACK_SIZE] __attribute__((aligned(16)));
+
+
+
+/****************************************************************************************************************//**
+*   @var                apStacks
+*   @brief              The top of each AP's kernel stack by CPU number, read by the AP trampoline in `entryAp.s`
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Addr_t apStacks[MAX_CPU];
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchSetIst(Cpu_t *cpu, Addr_t top)
+*   @brief              Point IST1 in a CPU's TSS at its page fault stack
+*
+*   @param              cpu                 The CPU
+*   @param              top                 The top of the page fault stack
 *///-----------------------------------------------------------------------------------------------------------------
 KRN_FUNC
-void ArchEarlyInit(void)
+void ArchSetIst(Cpu_t *cpu, Addr_t top)
+{
+    cpu->arch.tss.lowerIst1 = (uint32_t)top;
+    cpu->arch.tss.upperIst1 = (uint32_t)(top >> 32);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchLoadGdt(Cpu_t *cpu)
+*   @brief              Build this CPU's own GDT from `gdtFinal`, then load it along with the TSS and `gs`
+*
+*   Every CPU uses the same selectors: 0x98 for `gs` and 0xa0 for the TSS.
+*
+*   @param              cpu                 The structure for the CPU running this function
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchLoadGdt(Cpu_t *cpu)
 {
     extern uint64_t gdtFinal[];
 
+    for (int i = 0; i < GDT_ENTRIES; i ++) cpu->arch.gdt[i] = gdtFinal[i];
+
+    cpu->arch.gdt[0xa0>>3] = TSSL32_GDT((Addr_t)&cpu->arch.tss);
+    cpu->arch.gdt[0xa8>>3] = TSSU32_GDT((Addr_t)&cpu->arch.tss);
+
+    LGDT(cpu->arch.gdt, sizeof(cpu->arch.gdt) - 1);
+    LTR(0xa0);
+    asm __volatile ("mov %0,%%gs" :: "r"(0x98) : "memory");
+}
+
+
+
+/********************************************************************************************************************
+*   See `arch.h` for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void ArchEarlyInit(void)
+{
     IdtSetHandler( 0, 0x08, (Addr_t)int00, 0, 0);
     IdtSetHandler( 1, 0x08, (Addr_t)int01, 0, 0);
     IdtSetHandler( 2, 0x08, (Addr_t)int02, 0, 0);
@@ -84,7 +156,7 @@ void ArchEarlyInit(void)
     IdtSetHandler(11, 0x08, (Addr_t)int0b, 0, 0);
     IdtSetHandler(12, 0x08, (Addr_t)int0c, 0, 0);
     IdtSetHandler(13, 0x08, (Addr_t)int0d, 0, 0);
-    IdtSetHandler(14, 0x08, (Addr_t)int0e, 0, 0);
+    IdtSetHandler(14, 0x08, (Addr_t)int0e, 1, 0);
     IdtSetHandler(15, 0x08, (Addr_t)int0f, 0, 0);
     IdtSetHandler(16, 0x08, (Addr_t)int10, 0, 0);
     IdtSetHandler(17, 0x08, (Addr_t)int11, 0, 0);
@@ -110,19 +182,21 @@ void ArchEarlyInit(void)
 
     // -- go back and install the problem IRQ handlers
     IdtSetHandler(32, 0x08, (Addr_t)int20, 0, 0);
+    IdtSetHandler(IPI_TLB_SHOOTDOWN, 0x08, (Addr_t)intf0, 0, 0);
 
     //
     // -- Now, we need to establish the `gs` segment and the tss for this CPU
     //    -------------------------------------------------------------------
-    gdtFinal[0xa0>>3] = TSSL32_GDT((Addr_t)&cpus[0].arch.tss);
-    gdtFinal[0xa8>>3] = TSSU32_GDT((Addr_t)&cpus[0].arch.tss);
-    LTR(0xa0);
+    ArchSetIst(cpus[0], (Addr_t)&bootPfStack[PF_STACK_SIZE]);
+    ArchLoadGdt(cpus[0]);
 
-    asm __volatile ("mov %0,%%gs" :: "r"(0x98) : "memory");
     WRMSR(IA32_GS_BASE, 0);
-    WRMSR(IA32_KERNEL_GS_BASE, (Addr_t)cpus[0].cpu);
+    WRMSR(IA32_KERNEL_GS_BASE, (Addr_t)cpus[0]->cpu);
     SWAPGS();
 
+    TlbCpuOnline();
+    AddrSpaceCpuOnline();
+    ArchMmuInit();
     LapicInit();
 }
 
@@ -134,21 +208,20 @@ void ArchEarlyInit(void)
 KRN_FUNC
 void ArchApInit(void)
 {
-    extern uint64_t gdtFinal[];
-    int apicId = LapicGetId();
+    Cpu_t *cpu = cpus[CpuFromApicId(CpuidApicId())];
 
 
     //
-    // -- Now, we need to establish the `gs` segment and the tss for this CPU
-    //    -------------------------------------------------------------------
-    asm __volatile ("mov %0,%%gs" :: "r"(0x98 + (apicId * 24)) : "memory");
+    // -- Now, we need to establish the `gs` segment and the tss for this CPU; IST1 was set by the BP
+    //    -------------------------------------------------------------------------------------------
+    ArchLoadGdt(cpu);
+
     WRMSR(IA32_GS_BASE, 0);
-    WRMSR(IA32_KERNEL_GS_BASE, (Addr_t)cpus[apicId].cpu);
+    WRMSR(IA32_KERNEL_GS_BASE, (Addr_t)cpu);
     SWAPGS();
-
-    gdtFinal[(0xa0>>3) + (apicId * 3)] = TSSL32_GDT((Addr_t)&cpus[apicId].arch.tss);
-    gdtFinal[(0xa8>>3) + (apicId * 3)] = TSSU32_GDT((Addr_t)&cpus[apicId].arch.tss);
-    LTR(0xa0 + ((apicId * 3) << 3));
+    TlbCpuOnline();
+    AddrSpaceCpuOnline();
+    ArchMmuCpuOnline();
 
     LapicInit();
 }
@@ -158,47 +231,207 @@ void ArchApInit(void)
 /********************************************************************************************************************
 *   See `arch.h` for documentation
 *///-----------------------------------------------------------------------------------------------------------------
-KRN_FUNC
+INIT_FUNC
 void MoveTrampoline(void)
 {
     if (cpuCount == 1) return;
-    Addr_t stackBase = 0xffffc00000000000;
 
     struct Tramp_t {
         uint64_t jumpCode;
-        uint32_t apLock;
-        uint32_t apPml4;
-        uint64_t stack;
+        uint64_t apPml4;
         uint64_t entryPoint;
+        uint64_t stackTable;
+        uint64_t count;
     } __attribute__((packed)) *tramp = (struct Tramp_t *)TRAMP_OFF;
 
     extern uint8_t _smpStart[];
     extern uint8_t _smpEnd[];
+    extern uint8_t apIds[];
     extern Addr_t pml4;
 
+    uint32_t *ids = (uint32_t *)(TRAMP_OFF + (apIds - _smpStart));
+    int maxIds = (PAGE_SIZE - (apIds - _smpStart)) / sizeof(uint32_t);
+
+    if (cpuCount > maxIds) KernelPanic("The AP trampoline cannot hold the APIC ID of every CPU");
+
     MapPage(TRAMP_OFF, TRAMP_OFF >> 12, PG_KRN | PG_WRT);
     kMemMove(tramp, _smpStart, _smpEnd - _smpStart);
 
+    tramp->apPml4 = pml4;
+    tramp->entryPoint = (Addr_t)kInitAp;
+    tramp->stackTable = (Addr_t)apStacks;
+    tramp->count = cpuCount;
+
+    for (int i = 0; i < cpuCount; i ++) ids[i] = CpuApicId(i);
+
+
+    //
+    // -- Every AP gets its stacks before any of them is started; each finds its CPU number from its APIC ID and
+    //    takes the stack for that number.  Both stacks are backed in full from the AP's node, above a guard page.
+    //    The kernel stack is never backed lazily: the AP fills the zero pool and its table cache on it while
+    //    holding the PMM and MMU locks, which the lazy fault handler would need to take again.
+    //    -------------------------------------------------------------------------------------------------------
     for (int i = 1; i < cpuCount; i ++) {
-        cpus[i].status = CPU_STARTING;
+        Cpu_t *cpu = cpus[i];
+
+        Addr_t stack = KvaAlloc(4, KVA_GUARD);
+        if (!stack) KernelPanic("Unable to allocate a stack for an AP");
 
-        tramp->apLock = 0;
-        tramp->apPml4 = pml4;
-        tramp->stack = stackBase - (0x5000 * i);    // includes a guard page
-        tramp->entryPoint = (Addr_t)kInitAp;
+        for (int p = 0; p < 4; p ++) {
+            Frame_t f = PmmAllocateNode(cpu->node, PMM_TAG_STACK);
+            if (!f) KernelPanic("Unable to allocate a stack for an AP");
 
-        // -- map the stack for the new CPU
-        for (Addr_t s = tramp->stack - 0x4000; s < tramp->stack; s += 0x1000) {
-            MapPage(s, PmmAllocate(), PG_KRN | PG_WRT);
+            MapPage(stack + (p * PAGE_SIZE), f, PG_KRN | PG_WRT);
         }
 
-        LapicSendInit(i);
-        LapicSendSipi(i, TRAMP_OFF);
+        apStacks[i] = stack + 0x4000;
 
-        while (cpus[i].status == CPU_STARTING) {
-            // -- TODO: check for timeout and fail CPU Startup
+        Addr_t pfStack = KvaAlloc(PF_STACK_SIZE / PAGE_SIZE, KVA_GUARD);
+        if (!pfStack) KernelPanic("Unable to allocate a page fault stack for an AP");
+
+        for (int p = 0; p < PF_STACK_SIZE / PAGE_SIZE; p ++) {
+            Frame_t f = PmmAllocateNode(cpu->node, PMM_TAG_STACK);
+            if (!f) KernelPanic("Unable to allocate a page fault stack for an AP");
+
+            MapPage(pfStack + (p * PAGE_SIZE), f, PG_KRN | PG_WRT);
+        }
+
+        ArchSetIst(cpu, pfStack + PF_STACK_SIZE);
+        cpu->status = CPU_STARTING;
+    }
+
+
+    //
+    // -- INIT-SIPI-SIPI is pipelined: each step goes to every AP before the next step starts, so the APs come up
+    //    together.  A SIPI which reaches an AP that is already running is ignored.  The waits the MP spec asks for
+    //    (10ms after INIT, 200us between the SIPIs) are taken once per batch rather than once per AP.
+    //    -------------------------------------------------------------------------------------------------------
+    for (int i = 1; i < cpuCount; i ++) LapicSendInit(i);
+    PitDelay(10000);
+    for (int i = 1; i < cpuCount; i ++) LapicSendSipi(i, TRAMP_OFF);
+    PitDelay(200);
+    for (int i = 1; i < cpuCount; i ++) LapicSendSipi(i, TRAMP_OFF);
+
+
+    //
+    // -- Now wait once for all of them to check in
+    //    -----------------------------------------
+    for (int i = 1; i < cpuCount; i ++) {
+        // -- TODO: check for timeout and fail CPU Startup
+        DoorbellWait(&cpus[i]->status, CPU_STARTING);
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See `arch.h` for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+int ArchCacheColors(void)
+{
+    uint32_t a, b, c, d;
+    uint64_t waySize = 0;
+
+    CPUID(0, &a, &b, &c, &d);
+
+
+    //
+    // -- Walk the deterministic cache parameters and keep the outermost data or unified cache
+    //    ------------------------------------------------------------------------------------
+    if (a >= 4) {
+        uint32_t level = 0;
+
+        for (int i = 0; i < 16; i ++) {
+            CPUIDEX(4, i, &a, &b, &c, &d);
+
+            uint32_t type = a & 0x1f;
+            if (type == 0) break;                       // -- no more caches
+            if (type == 2) continue;                    // -- instruction cache
+
+            if (((a >> 5) & 0x7) >= level) {
+                level = (a >> 5) & 0x7;
+                waySize = (uint64_t)(c + 1) * ((b & 0xfff) + 1) * (((b >> 12) & 0x3ff) + 1);
+            }
+        }
+    }
+
+
+    //
+    // -- Otherwise, the extended leaf reports the L2 (and on AMD, the L3) size and an encoded associativity
+    //    --------------------------------------------------------------------------------------------------
+    if (waySize == 0) {
+        static const uint32_t assoc[16] = { 0, 1, 2, 0, 4, 0, 8, 0, 16, 0, 32, 48, 64, 96, 128, 0 };
+
+        CPUID(0x80000000, &a, &b, &c, &d);
+
+        if (a >= 0x80000006) {
+            CPUID(0x80000006, &a, &b, &c, &d);
+
+            uint64_t size = (uint64_t)(c >> 16) * 1024;
+            uint32_t ways = assoc[(c >> 12) & 0xf];
+
+            if ((d >> 18) != 0) {
+                size = (uint64_t)(d >> 18) * 512 * 1024;
+                ways = assoc[(d >> 12) & 0xf];
+            }
+
+            if (ways) waySize = size / ways;
         }
     }
+
+    int colors = 1;
+    while ((uint64_t)colors * 2 * PAGE_SIZE <= waySize) colors *= 2;
+
+    return colors;
 }
 
 
+
+/********************************************************************************************************************
+*   See `arch.h` for documentation
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchReleaseBootMemory(void)
+{
+    extern uint8_t _mbStart[];
+    extern uint8_t _mbEnd[];
+    extern uint8_t _smpStart[];
+    extern uint8_t _smpEnd[];
+    extern uint8_t idtr64[];
+
+    // -- read the temporary IDT location before the .entry section goes away
+    Frame_t idtFrame = *(uint32_t *)(idtr64 + 2) >> 12;
+
+
+    //
+    // -- The trampoline and the AP startup code: the APs have all left them behind
+    //    -------------------------------------------------------------------------
+    UnmapPage(TRAMP_OFF);
+    PmmReleaseRange(TRAMP_OFF >> 12, (TRAMP_OFF >> 12) + 1);
+
+    UnmapRange((Addr_t)_smpStart, ((Addr_t)_smpEnd - (Addr_t)_smpStart + PAGE_SIZE - 1) >> 12);
+    PmmReleaseRange(((Addr_t)_smpStart - KERNEL_BASE) >> 12, ((Addr_t)_smpEnd - KERNEL_BASE) >> 12);
+
+
+    //
+    // -- The .entry section (Multiboot header, 32-bit code and boot GDT) and the temporary IDT.  The boot stack
+    //    is not released: the BP is still running on it.
+    //    -----------------------------------------------------------------------------------------------------
+    UnmapRange((Addr_t)_mbStart, ((Addr_t)_mbEnd - (Addr_t)_mbStart + PAGE_SIZE - 1) >> 12);
+    PmmReleaseRange((Addr_t)_mbStart >> 12, (Addr_t)_mbEnd >> 12);
+    PmmReleaseRange(idtFrame, idtFrame + 1);
+
+
+    //
+    // -- Finally, drop the identity map.  Its tables are shared with the kernel image mapping, so only the PML4
+    //    entry is removed.  The APs ran through the identity map in the trampoline and may still cache it.
+    //    -----------------------------------------------------------------------------------------------------
+    TlbBatch_t batch;
+    TlbBatchInit(&batch, nullptr);
+
+    *(uint64_t *)GetPml4Entry(0) = 0;
+    TlbQueueAll(&batch);
+    TlbFlush(&batch);
+}
+
@@ -11,6 +11,13 @@
 *
 *   This file handles all the intricacies of the x86_64 MMU interface.
 *
+*   The paging tables are only ever reached through the recursive mapping (`GetPml4Entry()` and friends),
+*   \ref ArchMmuTableWindow, and \ref PhysToVirt.  `modules/kernel/bench` supplies host versions of these, so this
+*   file can also be built into a Linux program which runs it against a simulated physical memory.
+*
+*   Every change to the paging tables, and every walk which could meet a table as it is released, holds
+*   \ref mmuLock; the flushes which follow are made once the lock is released wherever they can be.
+*
 * ------------------------------------------------------------------------------------------------------------------
 *
 *   |     Date    | Tracker |  Version | Pgmr | Description
@@ -22,7 +29,284 @@
 
 
 #include "arch.h"
+#include "frame.h"
+#include "internals.h"
+#include "mmu.h"
 #include "pmm.h"
+#include "spinlock.h"
+#include "tlb.h"
+
+
+
+/****************************************************************************************************************//**
+*   @def                PTE_PRESENT
+*   @brief              The present bit of a paging entry
+*///-----------------------------------------------------------------------------------------------------------------
+#define PTE_PRESENT         0x01
+
+
+
+/****************************************************************************************************************//**
+*   @def                PTE_LARGE
+*   @brief              The PS bit: in a PDPT or PD entry, the entry maps a 1G or 2M page rather than a table
+*///-----------------------------------------------------------------------------------------------------------------
+#define PTE_LARGE           0x80
+
+
+
+/****************************************************************************************************************//**
+*   @def                PTE_HW_UPDATED
+*   @brief              The accessed and dirty bits, which the CPU sets and which do not change the translation
+*///-----------------------------------------------------------------------------------------------------------------
+#define PTE_HW_UPDATED      0x60
+
+
+
+/****************************************************************************************************************//**
+*   @def                PTE_FRAME_MASK
+*   @brief              The physical address bits of a paging entry
+*///-----------------------------------------------------------------------------------------------------------------
+#define PTE_FRAME_MASK      0x000ffffffffff000
+
+
+
+/****************************************************************************************************************//**
+*   @def                PAGES_2M
+*   @brief              The number of 4K pages covered by a PD entry
+*///-----------------------------------------------------------------------------------------------------------------
+#define PAGES_2M            ((size_t)512)
+
+
+
+/****************************************************************************************************************//**
+*   @def                PAGES_1G
+*   @brief              The number of 4K pages covered by a PDPT entry
+*///-----------------------------------------------------------------------------------------------------------------
+#define PAGES_1G            ((size_t)512 * 512)
+
+
+
+/****************************************************************************************************************//**
+*   @def                PAGES_512G
+*   @brief              The number of 4K pages covered by a PML4 entry
+*///-----------------------------------------------------------------------------------------------------------------
+#define PAGES_512G          ((size_t)512 * 512 * 512)
+
+
+
+/****************************************************************************************************************//**
+*   @def                MMU_FREE_MAX
+*   @brief              The number of emptied paging tables held back until the TLB is flushed
+*///-----------------------------------------------------------------------------------------------------------------
+#define MMU_FREE_MAX        16
+
+
+
+/****************************************************************************************************************//**
+*   @def                PAT_WC
+*   @brief              The memory type encoding for write-combining in the Page Attribute Table
+*///-----------------------------------------------------------------------------------------------------------------
+#define PAT_WC              0x01
+
+
+
+/****************************************************************************************************************//**
+*   @def                MMU_TABLE_CACHE
+*   @brief              The number of zeroed paging tables each CPU keeps on hand
+*///-----------------------------------------------------------------------------------------------------------------
+#define MMU_TABLE_CACHE     16
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            MmuFreeList_t
+*   @brief              Formalization of the \ref MmuFreeList_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MmuFreeList_t
+*   @brief              Paging tables which have been unlinked but may still be cached by a TLB
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct MmuFreeList_t {
+    int count;                                  //!< The number of tables held
+    Frame_t frame[MMU_FREE_MAX];                //!< The frames of the tables
+} MmuFreeList_t;
+
+
+
+/****************************************************************************************************************//**
+*   @typedef            MmuTableCache_t
+*   @brief              Formalization of the \ref MmuTableCache_t structure into a defined type
+*///----------------------------------------------------------------------------------------------------------------
+/****************************************************************************************************************//**
+*   @struct             MmuTableCache_t
+*   @brief              The zeroed paging tables held by a single CPU
+*
+*   Only the owning CPU touches its cache, with interrupts disabled, so no lock is needed.
+*///----------------------------------------------------------------------------------------------------------------
+typedef struct MmuTableCache_t {
+    int count;                                  //!< The number of tables held
+    Frame_t frame[MMU_TABLE_CACHE];             //!< The frames of the tables, all filled with zeros
+} MmuTableCache_t;
+
+
+
+/****************************************************************************************************************//**
+*   @var                mmuTableCache
+*   @brief              The zeroed paging tables held by this CPU
+*///-----------------------------------------------------------------------------------------------------------------
+PER_CPU
+static MmuTableCache_t mmuTableCache;
+
+
+
+/****************************************************************************************************************//**
+*   @var                mmuHas1G
+*   @brief              Does the CPU support 1G pages?
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static bool mmuHas1G;
+
+
+
+/****************************************************************************************************************//**
+*   @var                mmuLock
+*   @brief              Serializes every change to the paging tables, and every walk which could meet a table as it
+*                       is being released
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Spinlock_t mmuLock;
+
+
+
+/****************************************************************************************************************//**
+*   @var                mmuWindowTable
+*   @brief              The page table holding the MMU scratch pages, which is never released
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static Frame_t mmuWindowTable;
+
+
+
+/****************************************************************************************************************//**
+*   @var                mmuHasPat
+*   @brief              Does the CPU support the Page Attribute Table?
+*///-----------------------------------------------------------------------------------------------------------------
+KERNEL_BSS
+static bool mmuHasPat;
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t *PteBits(PageEntry_t *ent)
+*   @brief              Get a paging entry as its raw 64-bit value
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint64_t *PteBits(PageEntry_t *ent) {
+    Addr_t p = (Addr_t)ent;
+    return (uint64_t *)p;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 size_t ArchMmuRunTo(Addr_t a, size_t pages, size_t count)
+*   @brief              The number of pages from `a` to the next boundary of `pages` pages, limited to `count`
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+size_t ArchMmuRunTo(Addr_t a, size_t pages, size_t count) {
+    size_t rv = pages - ((a >> 12) & (pages - 1));
+    return (rv > count ? count : rv);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t ArchMmuLock(void)
+*   @brief              Disable interrupts and take \ref mmuLock
+*
+*   Shootdowns are answered while waiting, since the CPU holding the lock may be flushing the TLB and waiting on
+*   this one.
+*
+*   @returns            The flags to pass to \ref ArchMmuUnlock
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Addr_t ArchMmuLock(void)
+{
+    Addr_t flags = DisableInterrupts();
+
+    while (!SpinTryLock(&mmuLock)) {
+        TlbService();
+        PAUSE();
+    }
+
+    return flags;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuUnlock(Addr_t flags)
+*   @brief              Release \ref mmuLock and restore interrupts
+*
+*   @param              flags               The flags returned by \ref ArchMmuLock
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuUnlock(Addr_t flags)
+{
+    SpinUnlock(&mmuLock);
+    RestoreInterrupts(flags);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Frame_t ArchMmuTableGet(bool *clean)
+*   @brief              Get a frame for a paging table, from this CPU's cache when it holds one
+*
+*   @param              clean               Set to whether the frame is already filled with zeros
+*
+*   @returns            The frame, tagged \ref PMM_TAG_PGTABLE; 0 if there is no memory
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t ArchMmuTableGet(bool *clean)
+{
+    Addr_t flags = DisableInterrupts();
+    MmuTableCache_t *c = PerCpuThis(mmuTableCache);
+    Frame_t t = (c->count ? c->frame[-- c->count] : 0);
+
+    RestoreInterrupts(flags);
+
+    if (!t) t = PmmAllocateZeroed(PMM_TAG_PGTABLE);
+    *clean = (t != 0);
+
+    if (!t) t = PmmAllocate(PMM_TAG_PGTABLE);
+
+    return t;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool ArchMmuTablePut(Frame_t t)
+*   @brief              Keep a zeroed paging table in this CPU's cache
+*
+*   @param              t                   The frame, which must be filled with zeros
+*
+*   @returns            Whether the cache took the frame; if not, the caller still owns it
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool ArchMmuTablePut(Frame_t t)
+{
+    Addr_t flags = DisableInterrupts();
+    MmuTableCache_t *c = PerCpuThis(mmuTableCache);
+    bool rv = (c->count < MMU_TABLE_CACHE);
+
+    if (rv) c->frame[c->count ++] = t;
+
+    RestoreInterrupts(flags);
+
+    return rv;
+}
 
 
 
@@ -30,73 +314,691 @@
 *   See documentation in arch.h
 *///-----------------------------------------------------------------------------------------------------------------
 KRN_FUNC
-void ArchMmuMapPage(Addr_t a, Frame_t f, int flags)
+bool ArchMmuTableIdle(void)
 {
-    Frame_t t;
-    PageEntry_t *ent = GetPml4Entry(a);
+    bool low = (PerCpuRead(mmuTableCache.count) < MMU_TABLE_CACHE / 2);
 
-    if (!ent->p) {
-        t = PmmAllocate();
-        ent->frame = t;
-        ent->rw = 1;
-        ent->p = 1;
+    // -- leave the other half of the cache for the tables released by unmapping
+    if (!low) return false;
 
-        WBNOINVD();
-        INVLPG((Addr_t)GetPdptEntry(a));
+    Frame_t t = PmmAllocateZeroed(PMM_TAG_PGTABLE);
+    if (!t) return false;
 
-        uint64_t *tbl = (uint64_t *)((Addr_t)GetPdptEntry(a) & 0xfffffffffffff000);
-        for (int i = 0; i < 512; i ++) {
-            tbl[i] = 0;
-        }
+    if (!ArchMmuTablePut(t)) PmmFree(t);
+
+    return true;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuNewTable(PageEntry_t *ent, PageEntry_t *tbl)
+*   @brief              Allocate a new paging table and install it in a paging entry
+*
+*   A zeroed frame from this CPU's cache or the PMM's pool is used when one is available; otherwise the table is
+*   cleared through the recursive mapping once it is installed.  The entry was not present, so no other CPU can hold
+*   a translation through it; only the local invalidation of the recursive address is needed.
+*
+*   @param              ent                 The paging entry which will point to the new table
+*   @param              tbl                 The recursively-mapped address of the new table
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuNewTable(PageEntry_t *ent, PageEntry_t *tbl)
+{
+    bool clean;
+    Frame_t t = ArchMmuTableGet(&clean);
+    if (!t) KernelPanic("Unable to allocate a paging table");
+
+    ent->frame = t;
+    ent->rw = 1;
+    ent->p = 1;
+
+    INVLPG((Addr_t)tbl);
+
+    if (!clean) {
+        uint64_t *wrk = (uint64_t *)((Addr_t)tbl & 0xfffffffffffff000);
+        for (int i = 0; i < 512; i ++) wrk[i] = 0;
     }
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 uint64_t ArchMmuMakePte(Frame_t f, int flags)
+*   @brief              Build the value of a present page table entry
+*
+*   @param              f                   The frame to map
+*   @param              flags               The PG_* flags for the mapping
+*
+*   @returns            The page table entry
+*///-----------------------------------------------------------------------------------------------------------------
+INLINE
+uint64_t ArchMmuMakePte(Frame_t f, int flags) {
+    PageEntry_t ent;
+    *PteBits(&ent) = 0;
+
+    //
+    // -- PAT index 3 (PCD+PWT) is uncached; index 1 (PWT) is reprogrammed from write-through to write-combining.
+    //    The PAT bit is never set, so the index means the same in a large page.
+    //    ---------------------------------------------------------------------------------------------------------
+    ent.frame = f;
+    ent.rw = (flags&PG_WRT?1:0);
+    ent.pcd = ((flags&PG_DEV)||((flags&PG_WC)&&!mmuHasPat)?1:0);
+    ent.pwt = ((flags&PG_DEV)||(flags&PG_WC)?1:0);
+    ent.us = ((flags&PG_DEV)||(flags&PG_KRN)?1:0);
+    ent.k = (flags&PG_KRN?1:0);
+    ent.g = (flags&PG_KRN?1:0);
+    ent.p = 1;
+
+    return *PteBits(&ent);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuCpuOnline(void)
+{
+    if (!mmuHasPat) return;
+
+
+    //
+    // -- No mapping uses PAT index 1 until this is done, so no cached data of the old type needs to be flushed
+    //    ------------------------------------------------------------------------------------------------------
+    uint64_t pat = RDMSR(IA32_PAT);
+
+    pat &= ~((uint64_t)0xff << 8);
+    pat |= (uint64_t)PAT_WC << 8;
+    WRMSR(IA32_PAT, pat);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void ArchMmuShareKernel(void)
+{
+    Addr_t flags = ArchMmuLock();
+
+    for (Addr_t i = 256; i < 511; i ++) {
+        Addr_t a = 0xffff000000000000 | (i << 39);
+        PageEntry_t *ent = GetPml4Entry(a);
+
+        if (!ent->p) ArchMmuNewTable(ent, GetPdptEntry(a));
+    }
+
+    ArchMmuUnlock(flags);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Frame_t ArchMmuNewSpace(void)
+{
+    bool clean;
+    Frame_t pml4 = ArchMmuTableGet(&clean);
+    if (!pml4) return 0;
+
+    uint64_t *from = (uint64_t *)PhysToVirt(GetCr3() & PTE_FRAME_MASK);
+    uint64_t *to = (uint64_t *)PhysToVirt((Addr_t)pml4 << 12);
+
+    if (!clean) {
+        for (int i = 0; i < 256; i ++) to[i] = 0;
+    }
+
+    for (int i = 256; i < 511; i ++) to[i] = from[i];
+
+    to[511] = ((Addr_t)pml4 << 12) | PTE_PRESENT | 0x02;
+
+    return pml4;
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuSplit(PageEntry_t *ent, PageEntry_t *tbl, size_t step, TlbBatch_t *batch)
+*   @brief              Replace a large page with a table of smaller pages which map the same memory
+*
+*   The new table is filled through this CPU's MMU scratch page before it is installed, so the translation never
+*   disappears while other CPUs may be using it.
+*
+*   @param              ent                 The PDPT or PD entry holding the large page
+*   @param              tbl                 The recursively-mapped address of the new table
+*   @param              step                The number of frames each entry of the new table maps
+*   @param              batch               The batch which will invalidate the old translations
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuSplit(PageEntry_t *ent, PageEntry_t *tbl, size_t step, TlbBatch_t *batch)
+{
+    uint64_t large = *PteBits(ent);
+    uint64_t attrs = large & ~(uint64_t)PTE_FRAME_MASK;
+    Frame_t base = (large & PTE_FRAME_MASK) >> 12;
+
+    // -- in a page table entry, the PS bit position is the PAT bit
+    if (step == 1) attrs &= ~(uint64_t)PTE_LARGE;
+
+    bool clean;
+    Frame_t t = ArchMmuTableGet(&clean);
+    if (!t) KernelPanic("Unable to allocate a table to split a large page");
+
+    Addr_t flags = DisableInterrupts();
+    uint64_t *wrk = ArchMmuTableWindow(t);
+
+    for (int i = 0; i < 512; i ++) wrk[i] = attrs | ((uint64_t)(base + (i * step)) << 12);
+
+    *PteBits(ent) = ((uint64_t)t << 12) | PTE_PRESENT | 0x02;
+
+    RestoreInterrupts(flags);
+
+
+    //
+    // -- The recursive address of the new table used to reach into the large page itself, and may be cached under
+    //    any PCID
+    //    --------------------------------------------------------------------------------------------------------
+    INVLPG((Addr_t)tbl);
+    TlbQueueAll(batch);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 PageEntry_t *ArchMmuWalkPd(Addr_t a, TlbBatch_t *batch)
+*   @brief              Make sure the paging tables down to the page directory for an address exist
+*
+*   A 1G page in the way is split into 2M pages.
+*
+*   @param              a                   The address
+*   @param              batch               The batch which will invalidate any translations changed by a split
+*
+*   @returns            The recursively-mapped page directory entry for `a`
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+PageEntry_t *ArchMmuWalkPd(Addr_t a, TlbBatch_t *batch)
+{
+    PageEntry_t *ent = GetPml4Entry(a);
+    if (!ent->p) ArchMmuNewTable(ent, GetPdptEntry(a));
 
     ent = GetPdptEntry(a);
+    if (!ent->p) ArchMmuNewTable(ent, GetPdEntry(a));
+    else if (*PteBits(ent) & PTE_LARGE) ArchMmuSplit(ent, GetPdEntry(a), PAGES_2M, batch);
+
+    return GetPdEntry(a);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 PageEntry_t *ArchMmuWalk(Addr_t a, TlbBatch_t *batch)
+*   @brief              Make sure the paging tables down to the page table for an address exist
+*
+*   Any large page in the way is split.
+*
+*   @param              a                   The address
+*   @param              batch               The batch which will invalidate any translations changed by a split
+*
+*   @returns            The recursively-mapped page table entry for `a`
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+PageEntry_t *ArchMmuWalk(Addr_t a, TlbBatch_t *batch)
+{
+    PageEntry_t *ent = ArchMmuWalkPd(a, batch);
+
+    if (!ent->p) ArchMmuNewTable(ent, GetPtEntry(a));
+    else if (*PteBits(ent) & PTE_LARGE) ArchMmuSplit(ent, GetPtEntry(a), 1, batch);
+
+    return GetPtEntry(a);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+INIT_FUNC
+void ArchMmuInit(void)
+{
+    uint32_t a, b, c, d;
 
-    if (!ent->p) {
-        t = PmmAllocate();
-        ent->frame = t;
-        ent->rw = 1;
-        ent->p = 1;
+    CPUID(1, &a, &b, &c, &d);
+    mmuHasPat = ((d & CPUID_FEAT_EDX_PAT) != 0);
+
+    ArchMmuCpuOnline();
+
+
+    //
+    // -- Build the page table for the MMU scratch pages while this is the only CPU, so that ArchMmuTableWindow()
+    //    never walks or allocates; the address was never mapped, so there is nothing to flush
+    //    -------------------------------------------------------------------------------------------------------
+    TlbBatch_t batch;
+    TlbBatchInit(&batch, nullptr);
+
+    ArchMmuWalk(MMU_SCRATCH_ADDR, &batch);
+    mmuWindowTable = (*PteBits(GetPdEntry(MMU_SCRATCH_ADDR)) & PTE_FRAME_MASK) >> 12;
+
+    CPUID(0x80000000, &a, &b, &c, &d);
+    if (a < 0x80000001) return;
+
+    CPUID(0x80000001, &a, &b, &c, &d);
+    mmuHas1G = ((d & CPUID_EXT_EDX_PAGE1GB) != 0);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool ArchMmuSetLarge(PageEntry_t *ent, uint64_t val, Addr_t a, TlbBatch_t *batch)
+*   @brief              Install a large page in a PDPT or PD entry if the entry does not point to a table
+*
+*   A table is left alone, since replacing it would drop the mappings it holds.
+*
+*   @param              ent                 The PDPT or PD entry
+*   @param              val                 The large page entry to install
+*   @param              a                   The address mapped by the entry
+*   @param              batch               The batch which will invalidate the old translation
+*
+*   @returns            Whether the large page is in place
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool ArchMmuSetLarge(PageEntry_t *ent, uint64_t val, Addr_t a, TlbBatch_t *batch)
+{
+    uint64_t old = *PteBits(ent);
+
+    if ((old & PTE_PRESENT) && !(old & PTE_LARGE)) return false;
+    if ((old & ~(uint64_t)PTE_HW_UPDATED) == val) return true;
+
+    *PteBits(ent) = val;
+    if (old & PTE_PRESENT) TlbQueue(batch, a);
+
+    return true;
+}
 
-        WBNOINVD();
-        INVLPG((Addr_t)GetPdEntry(a));
 
-        uint64_t *tbl = (uint64_t *)((Addr_t)GetPdEntry(a) & 0xfffffffffffff000);
-        for (int i = 0; i < 512; i ++) tbl[i] = 0;
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuMapRange(Addr_t a, Frame_t f, size_t count, int flags)
+{
+    TlbBatch_t batch;
+    TlbBatchInit(&batch, a < USER_SPACE_END ? AddrSpaceCurrent() : nullptr);
+
+    Addr_t lockFlags = ArchMmuLock();
+
+    while (count) {
+        //
+        // -- Use the largest page which the alignment of both addresses and the remaining length allow
+        //    -----------------------------------------------------------------------------------------
+        Frame_t align = ((a >> 12) | f);
+
+        if (mmuHas1G && count >= PAGES_1G && (align & (PAGES_1G - 1)) == 0) {
+            PageEntry_t *ent = GetPml4Entry(a);
+            if (!ent->p) ArchMmuNewTable(ent, GetPdptEntry(a));
+
+            if (ArchMmuSetLarge(GetPdptEntry(a), ArchMmuMakePte(f, flags) | PTE_LARGE, a, &batch)) {
+                a += (Addr_t)PAGES_1G * PAGE_SIZE;
+                f += PAGES_1G;
+                count -= PAGES_1G;
+                continue;
+            }
+        }
+
+        if (count >= PAGES_2M && (align & (PAGES_2M - 1)) == 0) {
+            if (ArchMmuSetLarge(ArchMmuWalkPd(a, &batch), ArchMmuMakePte(f, flags) | PTE_LARGE, a, &batch)) {
+                a += (Addr_t)PAGES_2M * PAGE_SIZE;
+                f += PAGES_2M;
+                count -= PAGES_2M;
+                continue;
+            }
+        }
+
+
+        //
+        // -- Otherwise, walk the tables once for each run of entries in the same page table
+        //    ------------------------------------------------------------------------------
+        Addr_t tbl = (Addr_t)ArchMmuWalk(a, &batch);
+        uint64_t *pte = (uint64_t *)tbl;
+        size_t run = ArchMmuRunTo(a, PAGES_2M, count);
+
+        for (size_t i = 0; i < run; i ++) {
+            uint64_t old = pte[i];
+            uint64_t val = ArchMmuMakePte(f + i, flags);
+
+            if ((old & ~(uint64_t)PTE_HW_UPDATED) == val) continue;
+
+            pte[i] = val;
+
+            // -- only a change to a present mapping can leave a stale translation behind
+            if (old & PTE_PRESENT) TlbQueue(&batch, a + (i * PAGE_SIZE));
+        }
+
+        a += (Addr_t)run * PAGE_SIZE;
+        f += run;
+        count -= run;
     }
 
+    ArchMmuUnlock(lockFlags);
+
+    if (flags & PG_LOCAL) TlbFlushLocal(&batch);
+    else TlbFlush(&batch);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuMapPage(Addr_t a, Frame_t f, int flags)
+{
+    ArchMmuMapRange(a, f, 1, flags);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 bool ArchMmuIsMappedLocked(Addr_t a)
+*   @brief              Check whether an address is mapped; \ref mmuLock must be held
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool ArchMmuIsMappedLocked(Addr_t a)
+{
+    if (!GetPml4Entry(a)->p) return false;
+
+    PageEntry_t *ent = GetPdptEntry(a);
+    if (!ent->p) return false;
+    if (*PteBits(ent) & PTE_LARGE) return true;
+
     ent = GetPdEntry(a);
+    if (!ent->p) return false;
+    if (*PteBits(ent) & PTE_LARGE) return true;
+
+    return GetPtEntry(a)->p;
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+bool ArchMmuIsMapped(Addr_t a)
+{
+    Addr_t flags = ArchMmuLock();
+    bool rv = ArchMmuIsMappedLocked(a);
+
+    ArchMmuUnlock(flags);
+
+    return rv;
+}
+
+
 
-    if (!ent->p) {
-        t = PmmAllocate();
-        ent->frame = t;
-        ent->rw = 1;
-        ent->p = 1;
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuUnmapPage(Addr_t a)
+{
+    ArchMmuUnmapRange(a, 1);
+}
 
-        WBNOINVD();
-        INVLPG((Addr_t)GetPtEntry(a));
 
-        uint64_t *tbl = (uint64_t *)((Addr_t)GetPtEntry(a) & 0xfffffffffffff000);
-        for (int i = 0; i < 512; i ++) tbl[i] = 0;
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuFreeTables(MmuFreeList_t *fl, TlbBatch_t *batch)
+*   @brief              Flush the TLB and then return the held paging tables to this CPU's cache or the PMM
+*
+*   The tables are empty, so they are still filled with zeros and can be reused as they are.
+*
+*   @param              fl                  The tables to free
+*   @param              batch               The batch which invalidates any translations through them
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuFreeTables(MmuFreeList_t *fl, TlbBatch_t *batch)
+{
+    TlbFlush(batch);
+
+    for (int i = 0; i < fl->count; i ++) {
+        if (!ArchMmuTablePut(fl->frame[i])) PmmFree(fl->frame[i]);
     }
 
-    ent = GetPtEntry(a);
+    fl->count = 0;
+}
 
-    ent->frame = f;
-    ent->rw = (flags&PG_WRT?1:0);
-    ent->pcd = (flags&PG_DEV?1:0);
-    ent->pwt = (flags&PG_DEV?1:0);
-    ent->us = ((flags&PG_DEV)||(flags&PG_KRN)?1:0);
-    ent->k = (flags&PG_KRN?1:0);
-    ent->g = (flags&PG_KRN?1:0);
-    ent->p = 1;
 
-    WBNOINVD();
-    INVLPG((Addr_t)a);
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuReleaseTable(PageEntry_t *ent, PageEntry_t *tbl, MmuFreeList_t *fl, TlbBatch_t *batch)
+*   @brief              Unlink a paging table if it is empty and was allocated by the MMU
+*
+*   The tables built in `entry.s` are part of the kernel image and are never released.  The frame is held until the
+*   TLB is flushed, since other CPUs may still walk through it.
+*
+*   @param              ent                 The paging entry which points to the table
+*   @param              tbl                 Any recursively-mapped entry in the table
+*   @param              fl                  The tables waiting to be freed
+*   @param              batch               The batch which will invalidate any translations through the table
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuReleaseTable(PageEntry_t *ent, PageEntry_t *tbl, MmuFreeList_t *fl, TlbBatch_t *batch)
+{
+    uint64_t val = *PteBits(ent);
+    if (!(val & PTE_PRESENT) || (val & PTE_LARGE)) return;
+
+    Addr_t p = (Addr_t)tbl & ~(Addr_t)(PAGE_SIZE - 1);
+    uint64_t *wrk = (uint64_t *)p;
+
+    // -- entries are cleared to 0 when unmapped, so an empty table is all zeros and can be reused without clearing
+    for (int i = 0; i < 512; i ++) {
+        if (wrk[i]) return;
+    }
+
+    Frame_t t = (val & PTE_FRAME_MASK) >> 12;
+    if (t == mmuWindowTable) return;
+    if (!FrameIsAvailable(t) || FrameGetDesc(t)->owner != PMM_TAG_PGTABLE) return;
+
+    if (fl->count == MMU_FREE_MAX) ArchMmuFreeTables(fl, batch);
+
+    *PteBits(ent) = 0;
+    TlbQueueAll(batch);
+    fl->frame[fl->count ++] = t;
 }
 
 
 
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuPrune(Addr_t a, MmuFreeList_t *fl, TlbBatch_t *batch)
+*   @brief              Release the paging tables over an address which have become empty, from the bottom up
+*
+*   The kernel's PDPTs are shared by every address space and are never released.  The PML4 entry for `a` must be
+*   present.
+*
+*   @param              a                   The address whose mappings were removed
+*   @param              fl                  The tables waiting to be freed
+*   @param              batch               The batch which will invalidate any translations through the tables
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuPrune(Addr_t a, MmuFreeList_t *fl, TlbBatch_t *batch)
+{
+    PageEntry_t *pdpte = GetPdptEntry(a);
+
+    if (pdpte->p && !(*PteBits(pdpte) & PTE_LARGE)) {
+        ArchMmuReleaseTable(GetPdEntry(a), GetPtEntry(a), fl, batch);
+        ArchMmuReleaseTable(pdpte, GetPdEntry(a), fl, batch);
+    }
+
+    if (a < USER_SPACE_END) ArchMmuReleaseTable(GetPml4Entry(a), pdpte, fl, batch);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 void ArchMmuClearRange(Addr_t a, size_t count, TlbBatch_t *batch, MmuFreeList_t *fl)
+*   @brief              Clear the mappings for a run of pages, queuing the invalidations in a batch
+*
+*   @param              a                   The address of the first page
+*   @param              count               The number of pages
+*   @param              batch               The batch which will invalidate the old translations
+*   @param              fl                  Where to hold the paging tables left empty; `nullptr` to keep them
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuClearRange(Addr_t a, size_t count, TlbBatch_t *batch, MmuFreeList_t *fl)
+{
+    while (count) {
+        size_t run;
+        PageEntry_t *ent;
+        bool cleared = false;
+
+
+        //
+        // -- A missing table means the whole run it would cover is already unmapped
+        //    ----------------------------------------------------------------------
+        if (!GetPml4Entry(a)->p) {
+            run = ArchMmuRunTo(a, PAGES_512G, count);
+            goto next;
+        }
+
+        ent = GetPdptEntry(a);
+        run = ArchMmuRunTo(a, PAGES_1G, count);
+
+        if (!ent->p) goto next;
+
+        if (*PteBits(ent) & PTE_LARGE) {
+            if (run < PAGES_1G) {
+                ArchMmuSplit(ent, GetPdEntry(a), PAGES_2M, batch);
+                continue;
+            }
+
+            *PteBits(ent) = 0;
+            TlbQueue(batch, a);
+            cleared = true;
+            goto next;
+        }
+
+        ent = GetPdEntry(a);
+        run = ArchMmuRunTo(a, PAGES_2M, count);
+
+        if (!ent->p) goto next;
 
+        if (*PteBits(ent) & PTE_LARGE) {
+            if (run < PAGES_2M) {
+                ArchMmuSplit(ent, GetPtEntry(a), 1, batch);
+                continue;
+            }
 
+            *PteBits(ent) = 0;
+            TlbQueue(batch, a);
+            cleared = true;
+            goto next;
+        }
+
+        {
+            Addr_t tbl = (Addr_t)GetPtEntry(a);
+            uint64_t *pte = (uint64_t *)tbl;
+
+            for (size_t i = 0; i < run; i ++) {
+                if (!(pte[i] & PTE_PRESENT)) continue;
+
+                pte[i] = 0;
+                TlbQueue(batch, a + (i * PAGE_SIZE));
+                cleared = true;
+            }
+        }
+
+next:
+        if (cleared && fl) ArchMmuPrune(a, fl, batch);
+
+        a += (Addr_t)run * PAGE_SIZE;
+        count -= run;
+    }
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuUnmapRange(Addr_t a, size_t count)
+{
+    TlbBatch_t batch;
+    MmuFreeList_t fl;
+
+    TlbBatchInit(&batch, a < USER_SPACE_END ? AddrSpaceCurrent() : nullptr);
+    fl.count = 0;
+
+    Addr_t flags = ArchMmuLock();
+    ArchMmuClearRange(a, count, &batch, &fl);
+    ArchMmuUnlock(flags);
+
+    // -- the emptied tables are already unlinked, so they are freed outside the lock
+    ArchMmuFreeTables(&fl, &batch);
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+void ArchMmuUnmapRangeDeferred(Addr_t a, size_t count, TlbBatch_t *batch)
+{
+    Addr_t flags = ArchMmuLock();
+    ArchMmuClearRange(a, count, batch, nullptr);
+    ArchMmuUnlock(flags);
+}
+
+
+
+/****************************************************************************************************************//**
+*   @fn                 Addr_t ArchMmuVirtToPhysLocked(Addr_t a)
+*   @brief              Get the physical address behind a virtual address; \ref mmuLock must be held
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Addr_t ArchMmuVirtToPhysLocked(Addr_t a)
+{
+    if (!GetPml4Entry(a)->p) return 0;
+
+    PageEntry_t *ent = GetPdptEntry(a);
+    if (!ent->p) return 0;
+    if (*PteBits(ent) & PTE_LARGE) {
+        return (*PteBits(ent) & PTE_FRAME_MASK & ~(uint64_t)(PAGES_1G * PAGE_SIZE - 1))
+                | (a & (PAGES_1G * PAGE_SIZE - 1));
+    }
+
+    ent = GetPdEntry(a);
+    if (!ent->p) return 0;
+    if (*PteBits(ent) & PTE_LARGE) {
+        return (*PteBits(ent) & PTE_FRAME_MASK & ~(uint64_t)(PAGES_2M * PAGE_SIZE - 1))
+                | (a & (PAGES_2M * PAGE_SIZE - 1));
+    }
+
+    ent = GetPtEntry(a);
+    if (!ent->p) return 0;
+
+    return (*PteBits(ent) & PTE_FRAME_MASK) | (a & (PAGE_SIZE - 1));
+}
+
+
+
+/********************************************************************************************************************
+*   See documentation in arch.h
+*///-----------------------------------------------------------------------------------------------------------------
+KRN_FUNC
+Addr_t ArchMmuVirtToPhys(Addr_t a)
+{
+    Addr_t flags = ArchMmuLock();
+    Addr_t rv = ArchMmuVirtToPhysLocked(a);
+
+    ArchMmuUnlock(flags);
+
+    return rv;
+}
 
@@ -40,10 +40,13 @@
 
     global      entry
     global      earlyFrame
+    global      mbSig
+    global      mbData
     global      gdtFinal
     global      idtFinal
     global      gdtrFinal
     global      idtrFinal
+    global      idtr64
     global      pml4
 
 
@@ -471,25 +474,10 @@ gdtFinal:
     dq          0                               ;; GDT entry 0x88 (Future Use)
     dq          0                               ;; GDT entry 0x90 (Future Use)
 
-    ;; -- CPU0
-    dq          0x00a0920000000000              ;; GDT entry 0x98 (gs: for CPU0)
-    dq          0                               ;; GDT entry 0xa0 (reserved: Upper TSS for CPU0)
-    dq          0                               ;; GDT entry 0xa8 (reserved: Lower TSS for CPU0)
-
-    ;; -- CPU1
-    dq          0x00a0920000000000              ;; GDT entry 0xb0 (gs: for CPU1)
-    dq          0                               ;; GDT entry 0xb8 (reserved: Upper TSS for CPU1)
-    dq          0                               ;; GDT entry 0xc0 (reserved: Lower TSS for CPU1)
-
-    ;; -- CPU2
-    dq          0x00a0920000000000              ;; GDT entry 0xc8 (gs: for CPU2)
-    dq          0                               ;; GDT entry 0xd0 (reserved: Upper TSS for CPU2)
-    dq          0                               ;; GDT entry 0xd8 (reserved: Lower TSS for CPU2)
-
-    ;; -- CPU3
-    dq          0x00a0920000000000              ;; GDT entry 0xe0 (gs: for CPU3)
-    dq          0                               ;; GDT entry 0xe8 (reserved: Upper TSS for CPU3)
-    dq          0                               ;; GDT entry 0xf0 (reserved: Lower TSS for CPU3)
+    ;; -- Each CPU copies this table into its own GDT and fills in its TSS; see `ArchLoadGdt()`
+    dq          0x00a0920000000000              ;; GDT entry 0x98 (gs: for this CPU)
+    dq          0                               ;; GDT entry 0xa0 (reserved: Lower TSS for this CPU)
+    dq          0                               ;; GDT entry 0xa8 (reserved: Upper TSS for this CPU)
 gdtFinalEnd:
 
 gdtrFinal:                                      ;; this is the final GDT
@@ -16,15 +16,15 @@
 ;;     Date      Tracker  Version  Pgmr  Description
 ;;  -----------  -------  -------  ----  --------------------------------------------------------------------------
 ;;  2022-Mar-07  Initial  v0.0.1   ADCL  Initial version
+;;  2026-Oct-17  Initial  v0.0.3   ADCL  Start all the APs at once, each finding its stack by its APIC ID
+;;  2026-Oct-17  Initial  v0.0.3   ADCL  Find the CPU number from a table of 32-bit APIC IDs
 ;;
 ;;===================================================================================================================
 
 
 
     global      entryAp
-    global      apLock
-    global      kStack
-    global      eEntry
+    global      apIds
 
     extern      idtrFinal
     extern      gdtrFinal
@@ -47,18 +47,18 @@ entryAp:
 
     align       8
 
-apLock:
-    dd          0
-
 apPml4:
-    dd          0
-
-kStack:
     dq          0
 
 kEntry:
     dq          0
 
+apStackTable:                                   ;; the top of each CPU's stack, by CPU number
+    dq          0
+
+apCount:                                        ;; the number of entries in `apIds`
+    dq          0
+
 gdt64:
     dq          0                               ;; GDT entry 0x00 (NULL)
     dq          0x00a09a0000000000              ;; GDT entry 0x08 (KERNEL CODE)
@@ -78,25 +78,11 @@ overData:
     mov         ds,ax
     mov         es,ax
     mov         ss,ax
-    mov         sp,TRAMP_OFF + PAGE_SIZE
 
 ;;
-;; -- This is a safety net to keep only one core from moving on at a time.  There is a race to get here
-;;    when more than 1 core is started at a time.  The spinlock will work as a boundary to keep the others
-;;    at bay until it is safe to continue.
-;;    ----------------------------------------------------------------------------------------------------
-    mov         cx,1                            ;; this is the value to load
-    mov         bx,(apLock - entryAp) + TRAMP_OFF;; This is the address of apLock -- an offset from the seg start!
-
-loop:
-    mov         ax,0                            ;; this is the value it should be to load
-LOCK xchg       [bx],cx                         ;; do the xchg -- notice the LOCK prefix
-    cmp         ax,ax
-    jnz         loop                            ;; if the lock was not unlocked, loop
-
-;;
-;; -- only 1 core at a time gets here -- set up the stack segment register (real mode!)
-;;    ---------------------------------------------------------------------------------
+;; -- All the APs run through here at the same time.  Nothing below writes to the trampoline and nothing uses a
+;;    stack until each core has loaded its own, so there is no need to take turns.
+;;    ---------------------------------------------------------------------------------------------------------
     mov         al,0xff                         ;; Out 0xff to 0xA1 and 0x21 to disable all IRQs.
     out         0xa1,al
     out         0x21,al
@@ -144,7 +130,47 @@ LongMode:
     mov         fs,ax
     mov         gs,ax
     mov         ss,ax
-    mov         rsp,[(kStack - entryAp) + TRAMP_OFF]
+
+    xor         eax,eax                         ;; find the APIC ID: the x2APIC ID from leaf 0xb when it exists...
+    cpuid
+    cmp         eax,0xb
+    jb          .legacyId
+
+    mov         eax,0xb
+    xor         ecx,ecx
+    cpuid
+    test        ebx,ebx                         ;; ... leaf 0xb is not implemented if ebx is 0
+    jz          .legacyId
+    mov         eax,edx
+    jmp         .haveId
+
+.legacyId:                                      ;; ... otherwise the initial APIC ID in ebx[31:24] of leaf 1
+    mov         eax,1
+    cpuid
+    shr         ebx,24
+    mov         eax,ebx
+
+.haveId:
+    mov         rsi,(apIds - entryAp) + TRAMP_OFF
+    mov         rdx,[(apCount - entryAp) + TRAMP_OFF]
+    xor         rcx,rcx
+
+.find:                                          ;; the CPU number is the index of the APIC ID
+    cmp         rcx,rdx
+    jae         .lost
+    cmp         eax,[rsi+rcx*4]
+    je          .found
+    inc         rcx
+    jmp         .find
+
+.lost:                                          ;; the BP did not start this core; park it
+    cli
+    hlt
+    jmp         .lost
+
+.found:
+    mov         rax,[(apStackTable - entryAp) + TRAMP_OFF]
+    mov         rsp,[rax+rcx*8]
     mov         rbx,rsp
 
     mov         rax,idtrFinal
@@ -173,8 +199,14 @@ NewGdt:
     mov         fs,ax
     mov         gs,ax
 
-    mov         dword [(apLock - entryAp) + TRAMP_OFF],0
     mov         rax,(kEntry - entryAp) + TRAMP_OFF
     jmp         [rax]
 
 
+
+;;
+;; -- The APIC ID of each CPU, indexed by CPU number; the table fills the rest of the trampoline page
+;;    ----------------------------------------------------------------------------------------------
+    align       8
+
+apIds:
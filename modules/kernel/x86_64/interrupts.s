@@ -25,6 +25,8 @@
     extern      LapicGetId
     extern      LapicEoi
     extern      DbgPrintf
+    extern      TlbShootdownHandler
+    extern      LazyPageFault
 
     global      int00
     global      int01
@@ -59,6 +61,7 @@
     global      int1e
     global      int1f
     global      int20
+    global      intf0
     global      intxx
 
 
@@ -90,17 +93,19 @@ CPU_SERVICE     EQU                 7
 ;;
 ;; -- Macro to handle the setting up the interrupt/exception context.  The parameter is:
 ;;    What is the context for this handler? (i.e.: CPU_EXCEPTION)
+;;
+;;    Both fields are 32 bits; a 64-bit move would spill into the next field.
 ;;    ----------------------------------------------------------------------------------
 %macro SET_CONTEXT 1
     mov         rdi,[gs:8]                      ;; from the kernel data structure, get the cpu addr
     lea         rsi,[rdi+STATUS]                ;; load the address of the status field
     lea         rdi,[rdi+PREV_STS]              ;; load the address of the prev status field
 
-    mov         rax,[rsi]                       ;; get the current context
-    mov         [rdi],rax                       ;; save it for return
+    mov         eax,[rsi]                       ;; get the current context
+    mov         [rdi],eax                       ;; save it for return
 
-    mov         rax,%1                          ;; get the new context
-    mov         [rsi],rax                       ;; and set it
+    mov         eax,%1                          ;; get the new context
+    mov         [rsi],eax                       ;; and set it
 %endmacro
 
 
@@ -109,8 +114,8 @@ CPU_SERVICE     EQU                 7
     lea         rsi,[rdi+STATUS]                ;; load the address of the status field
     lea         rdi,[rdi+PREV_STS]              ;; load the address of the prev status field
 
-    mov         rax,[rdi]                       ;; get the prior context
-    mov         [rsi],rax                       ;; and set it
+    mov         eax,[rdi]                       ;; get the prior context
+    mov         [rsi],eax                       ;; and set it
 %endmacro
 
 
@@ -330,16 +335,19 @@ int0d:
 ;;    ------------------
 int0e:
     INT_PROLOG(1)
+    PUSHA
     SET_CONTEXT(CPU_EXCEPTION)
 
-    mov         rdi,msgInt0e
-    call        KernelPanic
+    mov         rdi,cr2                         ;; the faulting address
+    mov         rsi,[rsp+15*8]                  ;; the error code, above the saved registers
+    sub         rsp,8                           ;; keep the stack 16-byte aligned for the call
+    call        LazyPageFault                   ;; returns only if the fault was resolved
+    add         rsp,8
 
-;;
-;; -- if this interrupt returns, will need to determine if we need to swap gs again (sample below)
-;;    --------------------------------------------------------------------------------------------
-;    RESTORE_CONTEXT
-;    INT_EPILOG(1)
+    RESTORE_CONTEXT
+    POPA
+    add         rsp,8                           ;; drop the error code
+    INT_EPILOG(0)
 
 
 ;;
@@ -552,6 +560,24 @@ int20:
 
 
 
+;;
+;; -- TLB shootdown IPI; the registers are saved before the context is set since the interrupted code is live
+;;    -------------------------------------------------------------------------------------------------------
+intf0:
+    INT_PROLOG(0)
+    PUSHA
+    SET_CONTEXT(CPU_SERVICE)
+
+    call        TlbShootdownHandler
+    call        LapicEoi
+
+    RESTORE_CONTEXT
+    POPA
+    INT_EPILOG(0)
+
+
+
+
 ;;
 ;; -- IRQ or software-generated interrupt
 ;;    -----------------------------------
@@ -607,9 +633,6 @@ msgInt0c:
 msgInt0d:
     db          '#GP -- General Protection',0
 
-msgInt0e:
-    db          '#PF -- Page Fault',0
-
 msgInt0f:
     db          '0x0f -- Reserved Interrupt',0
 